@@ -3,39 +3,188 @@
 
 #include <iostream>
 #include <vector>
+#include <deque>
 #include <map>
+#include <unordered_map>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <sstream>
 #include <stdexcept>
+#include <memory_resource>
+#include <array>
+#include <cstddef>
 #include <functional>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <optional>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
 
 // Ethan Bossenbroek and Asa Rowntree March 2nd, 2025
 
+/**
+ * @class TrackingResource
+ * @brief A memory resource that counts what each subsystem holds from the system allocator.
+ *
+ * There is one resource per tag, each sitting under that subsystem's pools and arenas, so it sees only the
+ * pools' own (rare, large) upstream requests and its relaxed atomic counters cost nothing measurable.
+ * Tracking is opt-in: until enable() is called, get() hands out the plain new/delete resource.
+ */
+class TrackingResource : public std::pmr::memory_resource {
+public:
+    /**
+     * @enum Tag
+     * @brief The subsystems memory is attributed to.
+     */
+    enum class Tag {
+        World,     ///< Locations, items, text and indexes, per world version.
+        Session,   ///< Per-session state such as undo history.
+        Inventory, ///< The player's inventory.
+        Dialogue,  ///< NPC messages.
+        IO,        ///< Command buffers that outgrow their fixed storage.
+        Count      ///< Number of tags.
+    };
+
+    static void enable();  ///< Turns tracking on; resources taken before this stay untracked.
+    static bool enabled(); ///< Returns whether tracking is on.
+
+    /**
+     * @brief Returns the resource a subsystem should allocate from.
+     * @param tag The subsystem.
+     * @return The tag's tracking resource if tracking is on, otherwise the new/delete resource.
+     */
+    static std::pmr::memory_resource* get(Tag tag);
+
+    /**
+     * @brief Writes one line per tag: live bytes, peak bytes, live blocks and total blocks.
+     * @param os The output stream.
+     */
+    static void report(std::ostream& os);
+
+    TrackingResource() = default;
+    TrackingResource(const TrackingResource&) = delete;
+    TrackingResource& operator=(const TrackingResource&) = delete;
+
+private:
+    alignas(64) std::atomic<int64_t> liveBytes{0}; ///< Bytes currently held; on its own cache line per tag.
+    std::atomic<int64_t> peakBytes{0};   ///< The most bytes ever held at once.
+    std::atomic<int64_t> liveBlocks{0};  ///< Blocks currently held.
+    std::atomic<uint64_t> totalBlocks{0}; ///< Blocks ever allocated.
+
+    void* do_allocate(size_t bytes, size_t alignment) override; ///< Allocates from new/delete and counts the block.
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override; ///< Frees a block and uncounts it.
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override; ///< Only equal to itself.
+};
+
+class TextTable;
+
+/**
+ * @class Text
+ * @brief A handle to one compressed text in a TextTable; decoded only when written out.
+ */
+class Text {
+public:
+    Text() = default;
+
+    /**
+     * @brief Refers to encoded text inside a table.
+     * @param table The table holding the text.
+     * @param offset Byte offset of the encoded text.
+     * @param length Length of the encoded text in bytes.
+     */
+    Text(const TextTable& table, uint32_t offset, uint32_t length);
+
+    bool empty() const;      ///< Returns whether the text is empty.
+    std::string str() const; ///< Decodes the text into a string.
+
+    /**
+     * @brief Decodes the text straight into a stream.
+     * @param os The output stream.
+     * @param text The text to write.
+     * @return The output stream.
+     */
+    friend std::ostream& operator<<(std::ostream& os, const Text& text);
+
+private:
+    const TextTable* table = nullptr; ///< The table holding the text.
+    uint32_t offset = 0;              ///< Byte offset of the encoded text.
+    uint32_t length = 0;              ///< Length of the encoded text in bytes.
+};
+
+/**
+ * @class TextTable
+ * @brief Stores long text compressed against one shared word dictionary.
+ *
+ * Text is split into words, and each word is stored as a varint dictionary id with a low
+ * bit for "followed by one space", so phrases repeated across many descriptions cost a
+ * byte or two per word. Other whitespace runs are dictionary words of their own.
+ */
+class TextTable {
+public:
+    /**
+     * @brief Constructs an empty table.
+     * @param resource The memory resource the table allocates from.
+     */
+    explicit TextTable(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    TextTable(const TextTable&) = delete;
+    TextTable& operator=(const TextTable&) = delete;
+
+    Text add(std::string_view text); ///< Compresses text into the table and returns its handle.
+    void write(std::ostream& os, uint32_t offset, uint32_t length) const; ///< Decodes encoded text into a stream.
+    size_t wordCount() const;    ///< Returns the number of distinct words in the dictionary.
+    size_t encodedBytes() const; ///< Returns the size of all encoded text.
+
+private:
+    std::pmr::unordered_map<std::pmr::string, uint32_t> ids; ///< Word to dictionary id.
+    std::pmr::vector<const std::pmr::string*> words; ///< Dictionary id to word; points at the keys in ids, which never move.
+    std::pmr::vector<uint8_t> codes; ///< Every text's word ids, back to back.
+};
+
 /**
  * @class Item
  * @brief Represents an item in the game with a name, description, calories, and weight.
  */
 class Item {
 private:
-    std::string name;        ///< The name of the item.
-    std::string description; ///< A description of the item.
-    int calories;            ///< The number of calories (or "awesome points") the item provides.
-    float weight;            ///< The weight of the item in pounds.
+    std::pmr::string name;        ///< The name of the item.
+    Text description;             ///< A description of the item, compressed in the world's text table.
+    int calories;                 ///< The number of calories (or "awesome points") the item provides.
+    int weight;                   ///< The weight of the item in hundredths of a pound, so totals stay exact.
+    size_t id = static_cast<size_t>(-1); ///< The item's id in the world's item index; items with the same name share it.
 
 public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>; ///< Lets pmr containers hand their resource to the item's strings.
+
     /**
      * @brief Constructs an Item object.
      * @param name The name of the item.
      * @param description A description of the item.
      * @param calories The number of calories the item provides.
      * @param weight The weight of the item in pounds.
+     * @param alloc The allocator the item's strings are allocated from.
      * @throws std::invalid_argument If the name or description is empty, or if calories/weight are out of bounds.
      */
-    Item(const std::string& name, const std::string& description, int calories, float weight);
+    Item(std::string_view name, Text description, int calories, float weight, const allocator_type& alloc = {});
+    Item(const Item& other, const allocator_type& alloc); ///< Copies an item into another allocator.
+    Item(Item&& other, const allocator_type& alloc);      ///< Moves an item into another allocator.
+    Item(const Item& other) = default;
+    Item(Item&& other) = default;
+    Item& operator=(const Item& other) = default;
+    Item& operator=(Item&& other) = default;
 
-    std::string getName() const;        ///< Returns the name of the item.
-    std::string getDescription() const; ///< Returns the description of the item.
+    std::string_view getName() const;        ///< Returns the name of the item.
+    Text getDescription() const;             ///< Returns the description of the item.
     int getCalories() const;            ///< Returns the number of calories the item provides.
     float getWeight() const;            ///< Returns the weight of the item in pounds.
+    int getWeightHundredths() const;    ///< Returns the weight of the item in hundredths of a pound.
+    size_t getId() const;               ///< Returns the item's id in the world's item index.
+    void setId(size_t id);              ///< Sets the item's id in the world's item index.
 
     /**
      * @brief Overloads the << operator to print Item details.
@@ -46,31 +195,75 @@ public:
     friend std::ostream& operator<<(std::ostream& os, const Item& item);
 };
 
+/**
+ * @class DialogueArena
+ * @brief Stores every NPC message back to back in one contiguous buffer, addressed by offset/length.
+ */
+class DialogueArena {
+public:
+    /**
+     * @struct Span
+     * @brief The position of one message inside the arena.
+     */
+    struct Span {
+        uint32_t offset; ///< Byte offset of the message.
+        uint32_t length; ///< Length of the message in bytes.
+    };
+
+    /**
+     * @brief Constructs an empty arena.
+     * @param resource The memory resource the arena's buffer is allocated from.
+     */
+    explicit DialogueArena(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    Span add(std::string_view message); ///< Appends a message and returns its span.
+    std::string_view get(Span span) const; ///< Returns a view of the message at span.
+    size_t size() const; ///< Returns the number of bytes of dialogue stored.
+
+private:
+    std::pmr::string text; ///< All messages, concatenated.
+};
+
 /**
  * @class NPC
  * @brief Represents a non-player character (NPC) in the game with a name, description, and messages.
  */
 class NPC {
 private:
-    std::string name;                ///< The name of the NPC.
-    std::string description;         ///< A description of the NPC.
-    std::vector<std::string> messages; ///< A list of messages the NPC can say.
-    int messageNumber;               ///< The index of the current message to display.
+    std::pmr::string name;           ///< The name of the NPC.
+    Text description;                ///< A description of the NPC, compressed in the world's text table.
+    DialogueArena* dialogue;         ///< The arena the NPC's messages live in.
+    std::pmr::vector<DialogueArena::Span> messages; ///< The NPC's messages, as spans into the dialogue arena.
+    size_t messageNumber;            ///< The index of the current message to display.
+    size_t id;                       ///< The NPC's index in the world's NPC table.
 
 public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>; ///< Lets pmr containers hand their resource to the NPC's members.
+
     /**
      * @brief Constructs an NPC object.
      * @param name The name of the NPC.
      * @param description A description of the NPC.
+     * @param dialogue The arena the NPC's messages are stored in.
+     * @param alloc The allocator the NPC's members are allocated from.
      * @throws std::invalid_argument If the name or description is empty.
      */
-    NPC(const std::string& name, const std::string& description);
+    NPC(std::string_view name, Text description, DialogueArena& dialogue, const allocator_type& alloc = {});
+    NPC(const NPC& other, const allocator_type& alloc); ///< Copies an NPC into another allocator.
+    NPC(NPC&& other, const allocator_type& alloc);      ///< Moves an NPC into another allocator.
+    NPC(const NPC& other) = default;
+    NPC(NPC&& other) = default;
 
-    std::string getName() const;        ///< Returns the name of the NPC.
-    std::string getDescription() const; ///< Returns the description of the NPC.
+    std::string_view getName() const;        ///< Returns the name of the NPC.
+    Text getDescription() const;             ///< Returns the description of the NPC.
+    size_t getId() const;               ///< Returns the NPC's index in the world's NPC table.
+    void setId(size_t id);              ///< Sets the NPC's index in the world's NPC table.
 
-    void addMessage(const std::string& message); ///< Adds a message to the NPC's list of messages.
-    std::string getMessage();                    ///< Returns the next message in the NPC's list.
+    void addMessage(std::string_view message); ///< Adds a message to the NPC's list of messages.
+    void addMessage(DialogueArena::Span message); ///< Adds a message already stored in the dialogue arena.
+    std::string_view getMessage();               ///< Returns the next message in the NPC's list, without copying it.
+    size_t getMessageNumber() const;             ///< Returns the index of the next message to display.
+    void setMessageNumber(size_t number);        ///< Sets the next message to display, wrapping past the last one.
 
     /**
      * @brief Overloads the << operator to print the NPC's name.
@@ -81,47 +274,1057 @@ public:
     friend std::ostream& operator<<(std::ostream& os, const NPC& npc);
 };
 
+class World;
+
 /**
  * @class Location
  * @brief Represents a location in the game with a name, description, NPCs, items, and neighboring locations.
  */
 class Location {
 private:
-    std::string name;                ///< The name of the location.
-    std::string description;         ///< A description of the location.
-    std::vector<NPC> npcs;           ///< A list of NPCs in the location.
-    std::vector<Item> items;         ///< A list of items in the location.
-    bool visited;                    ///< Whether the location has been visited by the player.
+    std::pmr::string name;           ///< The name of the location.
+    Text description;                ///< A description of the location, compressed in the world's text table.
+    std::pmr::vector<size_t> npcs;   ///< Ids of the NPCs in the location, indexing the world's NPC table.
+    std::pmr::vector<Item> items;    ///< A list of items in the location.
+    size_t id;                       ///< The location's index in the world, used for per-session discovery.
 
 public:
-    std::map<std::string, Location*> neighbors; ///< A map of neighboring locations and their directions.
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>; ///< Lets pmr containers hand their resource to the location's members.
+
+    std::pmr::map<std::pmr::string, Location*> neighbors; ///< A map of neighboring locations and their directions.
 
     /**
      * @brief Constructs a Location object.
      * @param name The name of the location.
      * @param description A description of the location.
-     * @throws std::invalid_argument If the name or description is empty.
+     * @param alloc The allocator the location's members are allocated from.
+     * @throws std::invalid_argument If the name is empty.
      */
-    Location(const std::string& name, const std::string& description);
+    Location(std::string_view name, Text description, const allocator_type& alloc = {});
+    Location(const Location& other, const allocator_type& alloc); ///< Copies a location into another allocator.
+    Location(Location&& other, const allocator_type& alloc);      ///< Moves a location into another allocator.
+    Location(const Location& other) = default;
+    Location(Location&& other) = default;
 
-    std::map<std::string, Location*> get_locations() const; ///< Returns the map of neighboring locations.
-    void add_location(const std::string& direction, Location* location); ///< Adds a neighboring location.
-    void add_npc(NPC& npc); ///< Adds an NPC to the location.
-    std::vector<NPC>& get_npcs(); ///< Returns the list of NPCs in the location.
+    const std::pmr::map<std::pmr::string, Location*>& get_locations() const; ///< Returns the map of neighboring locations.
+    void add_location(std::string_view direction, Location* location); ///< Adds a neighboring location.
+    void add_npc(size_t npcId); ///< Places an NPC, by id, in the location.
+    const std::pmr::vector<size_t>& get_npcs() const; ///< Returns the ids of the NPCs in the location.
     void add_item(const Item& item); ///< Adds an item to the location.
+    Item& emplace_item(std::string_view name, Text description, int calories, float weight); ///< Builds an item directly in the location's allocator.
     void remove_item(const Item& item); ///< Removes an item from the location.
-    std::vector<Item> get_items() const; ///< Returns the list of items in the location.
-    void set_visited(); ///< Marks the location as visited.
-    bool get_visited() const; ///< Returns whether the location has been visited.
-    std::string getName() const; ///< Returns the name of the location.
+    const std::pmr::vector<Item>& get_items() const; ///< Returns the list of items in the location.
+    std::string_view getName() const; ///< Returns the name of the location.
+    Text getDescription() const; ///< Returns the description of the location.
+    void setDescription(Text description); ///< Replaces the description, e.g. when the location is paged in or out.
+    void clear_items(); ///< Removes every item and frees their storage.
+    size_t getId() const; ///< Returns the location's index in the world.
+    void setId(size_t id); ///< Sets the location's index in the world.
 
     /**
-     * @brief Overloads the << operator to print Location details.
+     * @brief Prints Location details, labelling neighbors from a session's discovery bitset.
      * @param os The output stream.
-     * @param location The Location object to print.
+     * @param world The world the location belongs to, for its NPC table and crowds.
+     * @param visited The visited bitset, indexed by location id.
      * @return The output stream.
      */
-    friend std::ostream& operator<<(std::ostream& os, const Location& location);
+    std::ostream& print(std::ostream& os, const World& world, const std::vector<bool>& visited) const;
+};
+
+/**
+ * @class TimingWheel
+ * @brief A hierarchical timing wheel: O(1) schedule and O(1) amortized firing per timer.
+ *
+ * Four levels of 64 slots cover 2^24 ticks; a timer is filed by how far away it is and cascades down a level each
+ * time its slot comes round, until it fires from level 0. Timers live in one node pool with an intrusive free list,
+ * so millions of pending timers cost a few words each and no per-timer allocation.
+ * @tparam T The payload handed back when a timer fires; keep it small.
+ */
+template <typename T>
+class TimingWheel {
+public:
+    static constexpr uint64_t maxDelay = (uint64_t(1) << 24) - 1; ///< Longer delays are clamped to this.
+
+    /**
+     * @brief Schedules a payload to fire after a delay.
+     * @param delay The delay in ticks; 0 fires on the next tick.
+     * @param payload The value handed to the fire callback.
+     */
+    void schedule(uint64_t delay, const T& payload) {
+        uint32_t node;
+        if (freeList != none) {
+            node = freeList;
+            freeList = nodes[node].next;
+            nodes[node].payload = payload;
+        } else {
+            node = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(Node{0, payload, none});
+        }
+        nodes[node].due = now + std::max<uint64_t>(1, std::min(delay, maxDelay));
+        insert(node);
+        ++pending;
+    }
+
+    /**
+     * @brief Advances time, firing every timer that comes due, by due tick; timers due on the same tick fire in the order
+     * they were filed into its slot.
+     * @param ticks How many ticks to advance.
+     * @param fire Called as fire(payload) for each due timer; it may schedule more timers.
+     */
+    template <typename Fire>
+    void advance(uint64_t ticks, Fire&& fire) {
+        for (; ticks > 0; --ticks) {
+            if (pending == 0) {
+                now += ticks; // Nothing to fire; jump straight to the target time
+                return;
+            }
+            ++now;
+
+            // Cascade higher levels whose slot just came round, before firing level 0
+            for (unsigned level = 1; level < levels && (now & ((uint64_t(1) << (levelBits * level)) - 1)) == 0; ++level) {
+                uint32_t node = take(level, (now >> (levelBits * level)) & slotMask);
+                while (node != none) {
+                    uint32_t next = nodes[node].next;
+                    insert(node);
+                    node = next;
+                }
+            }
+
+            uint32_t node = take(0, now & slotMask);
+            while (node != none) {
+                uint32_t next = nodes[node].next;
+                T payload = nodes[node].payload;
+                nodes[node].next = freeList;
+                freeList = node;
+                --pending;
+                fire(payload);
+                node = next;
+            }
+        }
+    }
+
+    size_t size() const { return pending; } ///< Returns the number of pending timers.
+    uint64_t time() const { return now; }   ///< Returns the current tick.
+
+private:
+    static constexpr unsigned levelBits = 6;  ///< log2 of the slots per level.
+    static constexpr unsigned levels = 4;     ///< The number of levels.
+    static constexpr uint64_t slotMask = (1 << levelBits) - 1;
+    static constexpr uint32_t none = UINT32_MAX; ///< The end of a node list.
+
+    /**
+     * @struct Node
+     * @brief One pending timer, linked into a slot or the free list.
+     */
+    struct Node {
+        uint64_t due;  ///< The tick the timer fires at.
+        T payload;     ///< The value handed back on firing.
+        uint32_t next; ///< The next node in the same slot or in the free list.
+    };
+
+    std::vector<Node> nodes; ///< Every node ever allocated.
+    std::array<std::array<uint32_t, 1 << levelBits>, levels> slots = makeEmptySlots(); ///< Heads of each slot's node list.
+    uint32_t freeList = none; ///< Head of the recycled node list.
+    uint64_t now = 0;         ///< The current tick.
+    size_t pending = 0;       ///< The number of scheduled timers.
+
+    static std::array<std::array<uint32_t, 1 << levelBits>, levels> makeEmptySlots() {
+        std::array<std::array<uint32_t, 1 << levelBits>, levels> empty;
+        for (auto& level : empty) level.fill(none);
+        return empty;
+    }
+
+    /// Files a node in the level whose span covers its remaining delay.
+    void insert(uint32_t node) {
+        uint64_t due = nodes[node].due;
+        uint64_t delta = due > now ? due - now : 0;
+        unsigned level = 0;
+        while (level + 1 < levels && delta >= (uint64_t(1) << (levelBits * (level + 1)))) ++level;
+        uint32_t& head = slots[level][(due >> (levelBits * level)) & slotMask];
+        nodes[node].next = head;
+        head = node;
+    }
+
+    /// Detaches and returns a slot's node list, reversed into the order the nodes were filed.
+    uint32_t take(unsigned level, uint64_t slot) {
+        uint32_t node = slots[level][slot];
+        slots[level][slot] = none;
+        uint32_t filed = none;
+        while (node != none) {
+            uint32_t next = nodes[node].next;
+            nodes[node].next = filed;
+            filed = node;
+            node = next;
+        }
+        return filed;
+    }
+};
+
+/**
+ * @class PersistentArray
+ * @brief An immutable fixed-size array whose versions share structure.
+ *
+ * Values sit in the leaves of a 32-way trie of reference-counted nodes. set() copies only the
+ * path to one leaf and returns a new version, so keeping every version costs O(log n) nodes per
+ * change, and diff() skips every subtree two versions still share. Nodes come from the memory
+ * resource the array was built with, which every version derived from it shares.
+ * @tparam T The element type; copied freely, so keep it small.
+ */
+template <typename T>
+class PersistentArray {
+public:
+    PersistentArray() = default;
+
+    /**
+     * @brief Builds an array with every element equal to fill, sharing one node per level.
+     * @param size The number of elements.
+     * @param fill The initial value of every element.
+     * @param resource The memory resource the nodes are allocated from.
+     */
+    explicit PersistentArray(size_t size, const T& fill = T{},
+                             std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : count(size), resource(resource) {
+        while ((size_t(1) << (bits * (shift / bits + 1))) < size) shift += bits;
+        auto node = makeNode();
+        node->values.assign(width, fill);
+        for (unsigned level = 0; level < shift; level += bits) {
+            auto parent = makeNode();
+            parent->children.assign(width, node);
+            node = std::move(parent);
+        }
+        root = std::move(node);
+    }
+
+    size_t size() const { return count; } ///< Returns the number of elements.
+
+    /**
+     * @brief Returns an element.
+     * @param index The element's index; must be less than size().
+     * @return The element.
+     */
+    const T& get(size_t index) const {
+        const Node* node = root.get();
+        for (unsigned level = shift; level > 0; level -= bits) {
+            node = node->children[(index >> level) & mask].get();
+        }
+        return node->values[index & mask];
+    }
+
+    /**
+     * @brief Returns a new version with one element replaced; this version is unchanged.
+     * @param index The element's index; must be less than size().
+     * @param value The new value.
+     * @return The new version.
+     */
+    PersistentArray set(size_t index, T value) const {
+        PersistentArray next(*this);
+        next.root = assign(root, shift, index, std::move(value));
+        return next;
+    }
+
+    /**
+     * @brief Calls changed(index) for every element that differs from another version of the same array.
+     * @param other A version with the same size.
+     * @param changed The callback.
+     */
+    template <typename Changed>
+    void diff(const PersistentArray& other, Changed&& changed) const {
+        compare(root.get(), other.root.get(), shift, 0, changed);
+    }
+
+private:
+    static constexpr unsigned bits = 5;          ///< log2 of the branching factor.
+    static constexpr size_t width = 1 << bits;   ///< Children or values per node.
+    static constexpr size_t mask = width - 1;
+
+    /**
+     * @struct Node
+     * @brief A trie node: branches fill children, leaves fill values.
+     */
+    struct Node {
+        explicit Node(std::pmr::memory_resource* resource) : children(resource), values(resource) {}
+        Node(const Node& other, std::pmr::memory_resource* resource)
+            : children(other.children, resource), values(other.values, resource) {}
+
+        std::pmr::vector<std::shared_ptr<const Node>> children; ///< Subtrees, in branch nodes.
+        std::pmr::vector<T> values;                             ///< Elements, in leaf nodes.
+    };
+
+    std::shared_ptr<const Node> root; ///< The trie; null only for a default-constructed array.
+    size_t count = 0;                 ///< The number of elements.
+    unsigned shift = 0;               ///< Index bits below the root level.
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource(); ///< Where nodes, and their control blocks, are allocated.
+
+    /// Allocates a node, and its reference count alongside it, from the array's resource.
+    template <typename... From>
+    std::shared_ptr<Node> makeNode(const From&... from) const {
+        return std::allocate_shared<Node>(std::pmr::polymorphic_allocator<Node>(resource), from..., resource);
+    }
+
+    /// Copies the path to index, replacing the element at its end.
+    std::shared_ptr<const Node> assign(const std::shared_ptr<const Node>& node, unsigned level, size_t index, T value) const {
+        auto copy = makeNode(*node);
+        if (level == 0) {
+            copy->values[index & mask] = std::move(value);
+        } else {
+            size_t slot = (index >> level) & mask;
+            copy->children[slot] = assign(node->children[slot], level - bits, index, std::move(value));
+        }
+        return copy;
+    }
+
+    /// Walks two tries in step, descending only where they stopped sharing nodes.
+    template <typename Changed>
+    void compare(const Node* a, const Node* b, unsigned level, size_t base, Changed& changed) const {
+        if (a == b) return;
+        if (level == 0) {
+            for (size_t i = 0; i < width && base + i < count; ++i) {
+                if (!(a->values[i] == b->values[i])) changed(base + i);
+            }
+            return;
+        }
+        for (size_t i = 0; i < width && base + (i << level) < count; ++i) {
+            compare(a->children[i].get(), b->children[i].get(), level - bits, base + (i << level), changed);
+        }
+    }
+};
+
+/**
+ * @struct TimedEvent
+ * @brief A world event declared with "at"/"every" in the world file and driven by the world's timing wheel.
+ */
+struct TimedEvent {
+    /**
+     * @enum Action
+     * @brief What the event does when it fires.
+     */
+    enum class Action {
+        Say,     ///< The NPC gains a new line of dialogue.
+        Respawn, ///< The item reappears at the location if it is gone.
+        Toggle,  ///< The exit closes if open, or reopens if closed.
+        Simulate ///< The crowd moves one step.
+    };
+
+    Action action;          ///< What the event does.
+    uint32_t period;        ///< Seconds between firings; 0 for one-shot events.
+    size_t location;        ///< The location for Respawn and Toggle.
+    size_t npc;             ///< The NPC for Say.
+    size_t item;            ///< The item template for Respawn, indexing World::itemTemplates.
+    DialogueArena::Span message; ///< The new line for Say.
+    std::string direction;  ///< The exit for Toggle.
+    Location* exitTarget;   ///< Where a closed exit leads, remembered until it reopens.
+};
+
+/**
+ * @class Crowd
+ * @brief Wandering NPCs simulated in bulk, stored as struct-of-arrays so a step is a flat sweep over plain arrays.
+ *
+ * Crowd members are instances of an archetype NPC: they share its name, description and dialogue and carry only a
+ * position, a rule and a random state. Each step moves every member by its rule (random walk, or the next hop toward
+ * a target) unless it stands somewhere avoided, in which case it leaves. Large crowds are split across threads, and
+ * the per-location member index that look/talk read is rebuilt once per step with a counting sort.
+ */
+class Crowd {
+public:
+    /**
+     * @enum Rule
+     * @brief How a member picks its next location.
+     */
+    enum class Rule : uint8_t {
+        Wander, ///< Random walk, sometimes staying put.
+        Seek    ///< The next hop on a shortest path toward a target location.
+    };
+
+    /**
+     * @brief Adds members to the crowd.
+     * @param archetype The NPC id the members are instances of.
+     * @param count How many members to add.
+     * @param location Where they start.
+     * @param rule How they move.
+     * @param target The location Seek members head for.
+     */
+    void add(size_t archetype, size_t count, size_t location, Rule rule, size_t target = 0);
+
+    void avoid(size_t location); ///< Makes members leave a location whenever they end up there.
+    void markGraphDirty();       ///< Notes that exits changed, so paths are recomputed on the next step.
+    void settle(const std::pmr::vector<Location>& locations); ///< Snapshots exits and builds the index without moving anyone.
+
+    /**
+     * @brief Moves every member one step and rebuilds the per-location index.
+     * @param locations The world's locations, for their exits.
+     */
+    void step(const std::pmr::vector<Location>& locations);
+
+    /**
+     * @brief Counts members of each archetype at a location.
+     * @param location The location id.
+     * @return Archetype NPC id and member count pairs, in archetype order.
+     */
+    std::vector<std::pair<size_t, size_t>> groupsAt(size_t location) const;
+
+    size_t countAt(size_t location, size_t archetype) const; ///< Returns how many members of an archetype are at a location.
+    size_t size() const; ///< Returns the number of members.
+
+private:
+    // One entry per member
+    std::vector<uint32_t> position;  ///< Current location id.
+    std::vector<uint32_t> archetype; ///< NPC id the member is an instance of.
+    std::vector<uint32_t> target;    ///< Index into targets for Seek members.
+    std::vector<Rule> rule;          ///< How the member moves.
+    std::vector<uint32_t> seed;      ///< xorshift32 state.
+
+    // Location graph snapshot, in compressed sparse row form
+    std::vector<uint32_t> edgeStart; ///< Where each location's exits start in edges; one extra entry at the end.
+    std::vector<uint32_t> edges;     ///< Exit destinations.
+    std::vector<uint32_t> targets;   ///< Distinct Seek targets.
+    std::vector<uint32_t> nextHop;   ///< [target slot * location count + location] -> next location toward the target.
+    std::vector<uint32_t> escape;    ///< Where to go from each location; differs from the location only where avoided.
+    std::vector<uint32_t> avoided;   ///< Locations members leave.
+    bool graphDirty = true;          ///< Whether the snapshot must be rebuilt before the next step.
+
+    // Per-location member index, rebuilt after each step
+    std::vector<uint32_t> memberStart; ///< Where each location's members start in members; one extra entry at the end.
+    std::vector<uint32_t> members;     ///< Member indexes grouped by location.
+
+    void rebuildGraph(const std::pmr::vector<Location>& locations); ///< Snapshots exits and recomputes paths.
+    void rebuildIndex(size_t locationCount); ///< Regroups members by location.
+    void move(size_t begin, size_t end, size_t locationCount); ///< Steps members [begin, end).
+};
+
+/**
+ * @class SearchIndex
+ * @brief An inverted index over location, item and NPC text.
+ *
+ * Each term maps to a posting list of (document, term frequency) pairs, stored as
+ * delta-encoded varints in one shared byte buffer. Queries decode only the lists of
+ * their own terms and rank documents by how many terms they match, then by tf-idf.
+ */
+class SearchIndex {
+public:
+    /**
+     * @enum Kind
+     * @brief What a document describes.
+     */
+    enum class Kind : uint8_t {
+        Location,
+        Item,
+        NPC
+    };
+
+    /**
+     * @struct Hit
+     * @brief One ranked search result.
+     */
+    struct Hit {
+        Kind kind;             ///< What matched.
+        size_t id;             ///< The location or NPC id; for items, the location the item was placed in.
+        std::string_view name; ///< The matched location's, item's or NPC's name.
+        size_t matched;        ///< How many distinct query terms the document contains.
+        double score;          ///< tf-idf relevance; higher is better.
+    };
+
+    explicit SearchIndex(std::pmr::memory_resource* resource); ///< Builds an empty index allocating from resource.
+
+    /**
+     * @brief Indexes one document. Documents must be added before finish().
+     * @param kind What the document describes.
+     * @param id The location or NPC id the document refers to.
+     * @param name The document's name; its terms count more than the text's.
+     * @param text The document's description.
+     */
+    void add(Kind kind, size_t id, std::string_view name, std::string_view text);
+
+    void finish(); ///< Compresses the posting lists gathered by add() and drops the build buffers.
+
+    /**
+     * @brief Finds the documents that best match a query.
+     * @param query Words to look for, in any case.
+     * @param limit The most hits to return.
+     * @return Hits, best first.
+     */
+    std::vector<Hit> find(std::string_view query, size_t limit) const;
+
+    size_t documentCount() const; ///< Returns the number of indexed documents.
+    size_t postingBytes() const;  ///< Returns the size of the compressed posting lists.
+
+private:
+    /**
+     * @struct Document
+     * @brief An indexed location, item or NPC.
+     */
+    struct Document {
+        Kind kind;               ///< What the document describes.
+        uint32_t id;             ///< The location or NPC id.
+        DialogueArena::Span name; ///< The document's name in the names arena.
+    };
+
+    /**
+     * @struct Postings
+     * @brief Where a term's compressed posting list lives.
+     */
+    struct Postings {
+        uint32_t offset;    ///< Byte offset into the posting buffer.
+        uint32_t bytes;     ///< Encoded length in bytes.
+        uint32_t documents; ///< Number of documents containing the term.
+    };
+
+    DialogueArena names; ///< Document names, packed into one buffer.
+    std::pmr::vector<Document> documents; ///< Every document, indexed by document id.
+    std::pmr::unordered_map<std::pmr::string, Postings> terms; ///< Term to posting list.
+    std::pmr::vector<uint8_t> postings; ///< Every posting list, back to back.
+    std::pmr::unordered_map<std::pmr::string, std::pmr::vector<uint32_t>> building; ///< Term to raw (document, frequency) pairs until finish(); on the default resource so finish() really frees it.
+};
+
+/**
+ * @class RegionStore
+ * @brief Keeps a streamed world's bulky location contents on disk, paging them in by region.
+ *
+ * Consecutive location ids form a region. Descriptions and item placement are spilled to a private
+ * temporary file at load; a region is read back on first entry and evicted least-recently-used once
+ * more than the budget are resident. Evicted regions whose items changed are written back as a new
+ * block. A worker thread prefetches the regions a location's exits lead into, so crossing a region
+ * border usually finds the page already decoded. Location skeletons (names, exits, NPC lists), the name lookup and
+ * the search index are not paged; they stay in the World.
+ */
+class RegionStore {
+public:
+    static constexpr size_t regionSize = 256; ///< Locations per region.
+
+    /**
+     * @struct Page
+     * @brief A region's contents as read from disk.
+     */
+    struct Page {
+        std::unique_ptr<TextTable> text;  ///< The region's descriptions, compressed; owned by the store while resident.
+        std::vector<Text> descriptions;   ///< Each location's description, by offset from the region's first id.
+        std::vector<std::pair<uint32_t, uint32_t>> items; ///< (location id, item id) for every item, sorted.
+    };
+
+    /**
+     * @brief Opens an empty store.
+     * @param locationCount How many locations the world has.
+     * @param budget How many regions may be resident at once; at least 2.
+     * @throws std::runtime_error If the spill file cannot be created.
+     */
+    RegionStore(size_t locationCount, size_t budget);
+    ~RegionStore(); ///< Stops the prefetcher and deletes the spill file.
+    RegionStore(const RegionStore&) = delete;
+    RegionStore& operator=(const RegionStore&) = delete;
+
+    void addDescription(size_t location, std::string_view text); ///< Spills a description; call in location id order while loading.
+    void addItem(size_t location, size_t item); ///< Records an item placement while loading.
+    void finish(); ///< Spills the item placements and starts the prefetcher.
+
+    size_t regionOf(size_t location) const; ///< Returns the region a location belongs to.
+    size_t budget() const;                  ///< Returns how many regions may be resident.
+    size_t residentCount() const;           ///< Returns how many regions are resident.
+    bool isResident(size_t region) const;   ///< Returns whether a region is paged in.
+    void markUsed(size_t region);           ///< Marks a resident region most recently used.
+    size_t coldest() const;                 ///< Returns the least recently used resident region.
+
+    /**
+     * @brief Pages a region in: takes its prefetched page, or reads it now.
+     * @param region The region, which must not be resident.
+     * @return The page; its text stays with the store until the region is released.
+     */
+    Page take(size_t region);
+
+    /**
+     * @brief Pages a region out, writing its items back if they changed since it was paged in.
+     * @param region The resident region.
+     * @param items (location id, item id) for every item now in the region.
+     */
+    void release(size_t region, std::vector<std::pair<uint32_t, uint32_t>> items);
+
+    void prefetch(size_t region); ///< Asks the worker to read a region ahead of need. Never blocks.
+
+private:
+    /**
+     * @struct Region
+     * @brief Where a region's blocks are in the spill file, and its residency.
+     */
+    struct Region {
+        uint64_t textOffset = 0;  ///< Spill offset of the description block.
+        uint64_t textLength = 0;  ///< Length of the description block.
+        uint64_t itemOffset = 0;  ///< Spill offset of the item block.
+        uint64_t itemLength = 0;  ///< Length of the item block.
+        bool resident = false;    ///< Whether the region is paged in.
+        std::unique_ptr<TextTable> text; ///< The resident region's descriptions.
+        std::vector<std::pair<uint32_t, uint32_t>> pagedItems; ///< The items as paged in, to detect changes.
+        std::list<size_t>::iterator used; ///< The region's entry in the recency list while resident.
+    };
+
+    std::FILE* spill;                 ///< The spill file; deleted when closed.
+    uint64_t spillEnd = 0;            ///< Where the next block is written.
+    std::vector<Region> regions;      ///< Every region, by region number.
+    std::list<size_t> recency;        ///< Resident regions, most recently used first.
+    size_t maxResident;               ///< The residency budget.
+    size_t locationCount;             ///< How many locations the world has.
+    std::vector<std::pair<uint32_t, uint32_t>> loadingItems; ///< Item placements gathered until finish().
+
+    std::mutex mutex;                 ///< Guards the prefetch queue, ready pages and block offsets.
+    std::mutex ioMutex;               ///< Serializes spill file access.
+    std::condition_variable wake;     ///< Signals queued work and finished reads.
+    std::deque<size_t> queue;         ///< Regions waiting to be prefetched.
+    std::map<size_t, Page> ready;     ///< Prefetched pages not yet taken.
+    std::deque<size_t> readyOrder;    ///< The ready regions, oldest request first.
+    size_t loading;                   ///< The region the worker is reading, or none.
+    bool stopping = false;            ///< Tells the worker to exit.
+    std::thread worker;               ///< The prefetch thread.
+
+    Page read(size_t region);         ///< Reads and decodes a region's blocks.
+    void write(const void* data, size_t length, uint64_t offset); ///< Writes to the spill file.
+    void run();                       ///< The prefetch thread's loop.
+};
+
+/**
+ * @class World
+ * @brief All shared world data: locations, NPCs and their dialogue, and the name indexes.
+ *
+ * A World is built in one go (from the built-in data or a world file) and replaced as a whole on reload. Sessions hold
+ * it through a shared_ptr, so an old version is freed once the last session has moved on to the new one.
+ *
+ * World files are line based; '#' starts a comment and fields are separated by '|':
+ *   location <name> | <description>
+ *   npc <name> | <description>
+ *   say <npc> | <message>
+ *   place <npc> | <location>
+ *   item <location> | <name> | <description> | <calories> | <weight>  (lines sharing a name must match)
+ *   exit <location> | <direction> | <location>
+ *   at <seconds> | say | <npc> | <message>          (the NPC gains a line once; 'say' cannot repeat)
+ *   every <seconds> | respawn | <location> | <item>  (the item reappears if it is gone)
+ *   every <seconds> | toggle | <location> | <direction>  (the exit closes, then reopens)
+ *   crowd <npc> | <count> | <location> | wander            (instances of the NPC roam at random)
+ *   crowd <npc> | <count> | <location> | seek | <target>   (instances of the NPC head for the target)
+ *   avoid <location>                                       (crowds leave the location)
+ */
+class World {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1); ///< Returned by the lookups when nothing matches.
+
+    World() = default;
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+
+    /**
+     * @brief Builds a world from world-file text.
+     * @param in The stream to read; it is read several times, so it must be seekable.
+     * @param residentRegions If nonzero, stream location contents through a RegionStore with this budget.
+     * @return The new world.
+     * @throws std::runtime_error Naming the offending line if the data is malformed.
+     */
+    static std::shared_ptr<World> parse(std::istream& in, size_t residentRegions = 0);
+
+    /**
+     * @brief Builds a world from a world file.
+     * @param path The file to read.
+     * @param residentRegions If nonzero, stream location contents through a RegionStore with this budget.
+     * @return The new world.
+     * @throws std::runtime_error If the file cannot be read or is malformed.
+     */
+    static std::shared_ptr<World> load(const std::string& path, size_t residentRegions = 0);
+
+    /**
+     * @brief Builds a world from a copy of a world file, keeping the copy so this version can be loaded again later.
+     * @param path The file to copy and read.
+     * @param residentRegions If nonzero, stream location contents through a RegionStore with this budget.
+     * @param directory Where versions are kept, each under versionPath() of its fingerprint.
+     * @return The new world.
+     * @throws std::runtime_error If the file cannot be copied or read, or is malformed.
+     */
+    static std::shared_ptr<World> loadVersion(const std::string& path, size_t residentRegions, const std::string& directory);
+
+    static std::string versionPath(const std::string& directory, uint32_t fingerprint); ///< Returns where loadVersion() keeps a world version.
+
+    static std::shared_ptr<World> builtIn(); ///< Builds the festival shipped with the game.
+
+    size_t indexOf(std::string_view name) const;    ///< Returns a location's index by case-insensitive name, or npos.
+    size_t npcIndexOf(std::string_view name) const; ///< Returns an NPC's id by case-insensitive name, or npos.
+    size_t itemIndexOf(std::string_view name) const; ///< Returns an item's id by case-insensitive name, or npos.
+    size_t internItem(const Item& item); ///< Returns an item's id by name, assigning the next id to new names.
+    void touch(size_t location); ///< Pages in a location's region and prefetches its neighbors'; does nothing unless streaming.
+
+    /**
+     * @brief Advances the world clock, firing due timed events.
+     * @param seconds The seconds elapsed since the last call.
+     * @param notify Called with a location id and a line to show players there.
+     */
+    void tick(uint64_t seconds, const std::function<void(size_t, std::string_view)>& notify);
+
+    // Resources are declared first so they outlive everything allocated from them.
+    std::pmr::monotonic_buffer_resource arena{TrackingResource::get(TrackingResource::Tag::World)}; ///< Backs all world data; freed with the world.
+    std::pmr::unsynchronized_pool_resource pool{&arena}; ///< Recycles world blocks that change at runtime (e.g. dropped items).
+
+    TextTable text{&arena}; ///< Every location, item and NPC description, compressed against one dictionary.
+    std::pmr::vector<Location> locations{&pool}; ///< Every location, indexed by location id.
+    std::pmr::deque<NPC> npcs{&pool}; ///< Every NPC, stored once and referenced by id.
+    DialogueArena dialogue{TrackingResource::get(TrackingResource::Tag::Dialogue)}; ///< Every NPC message, packed into one buffer; off the arena since it grows at runtime.
+    std::pmr::unordered_map<std::pmr::string, size_t> locationIndex{&pool}; ///< Lowercase location name to location id.
+    std::pmr::unordered_map<std::pmr::string, size_t> npcIndex{&pool}; ///< Lowercase NPC name to NPC id.
+    std::pmr::unordered_map<std::pmr::string, size_t> itemIndex{&pool}; ///< Lowercase item name to item id.
+    std::pmr::vector<Item> itemKinds{&pool}; ///< One item of each id, for rebuilding items from their ids.
+    std::pmr::vector<Item> itemTemplates{&pool}; ///< Items that respawn events copy back into the world.
+    std::vector<TimedEvent> events; ///< Timed event definitions.
+    TimingWheel<uint32_t> timers; ///< Pending firings, as indexes into events; one tick is one second.
+    Crowd crowd; ///< Wandering instances of archetype NPCs.
+    SearchIndex search{&arena}; ///< Index over every location, item and NPC description, built at load.
+    std::unique_ptr<RegionStore> regions; ///< Pages location contents in and out; null when the whole world is resident.
+    uint32_t fingerprint = 0; ///< Hash of the world file's directives, ignoring comments and blank lines; identifies the version in journals.
+
+    static constexpr uint32_t crowdInterval = 5; ///< Seconds between crowd steps.
+
+private:
+    void fire(TimedEvent& event, const std::function<void(size_t, std::string_view)>& notify); ///< Applies one timed event.
+    void evict(size_t region); ///< Pages a region's contents out.
+};
+
+/**
+ * @class WorldWatcher
+ * @brief Watches a world file and rebuilds the World on a background thread whenever it changes.
+ *
+ * Uses inotify on Linux and modification-time polling elsewhere. A finished world is published with an atomic
+ * pointer store, so sessions pick it up between batches without ever waiting on a rebuild.
+ */
+class WorldWatcher {
+public:
+    /**
+     * @brief Starts watching a world file.
+     * @param path The world file.
+     * @param residentRegions The region budget rebuilt worlds stream with, or 0 to load them whole.
+     * @param versions If not empty, the directory each rebuilt version is kept in (see World::loadVersion()).
+     */
+    explicit WorldWatcher(const std::string& path, size_t residentRegions = 0, const std::string& versions = "");
+    ~WorldWatcher(); ///< Stops the watcher thread.
+    WorldWatcher(const WorldWatcher&) = delete;
+    WorldWatcher& operator=(const WorldWatcher&) = delete;
+
+    std::shared_ptr<World> poll(); ///< Takes the most recently rebuilt world, or nullptr if none is waiting. Never blocks.
+
+private:
+    std::string path;               ///< The watched world file.
+    size_t residentRegions;         ///< The region budget rebuilt worlds stream with.
+    std::string versions;           ///< Where rebuilt versions are kept, or empty to keep none.
+    std::shared_ptr<World> pending; ///< The latest rebuilt world; only touched through std::atomic_* functions.
+    std::atomic<bool> stopping{false}; ///< Tells the watcher thread to exit.
+    std::thread thread;             ///< The watcher thread.
+
+    void run();     ///< The watcher thread's loop.
+    void rebuild(); ///< Loads the file and publishes the result, keeping the old world on errors.
+};
+
+/**
+ * @class SpectatorFeed
+ * @brief A single-producer, multi-consumer broadcast ring of session output.
+ *
+ * The session thread publishes text into fixed-size slots, overwriting the oldest, and never
+ * waits for or even knows about readers. Each slot carries a seqlock-style sequence number so
+ * a reader can tell a finished message from one still being written or already overwritten;
+ * readers that fall a whole ring behind skip ahead. Publishing therefore costs the same with
+ * no spectators or thousands.
+ */
+class SpectatorFeed {
+public:
+    static constexpr size_t slotBytes = 240; ///< Text per slot; longer text spans several slots.
+
+    /**
+     * @brief Builds an empty feed.
+     * @param slotCount How many slots the ring holds; rounded up to a power of two.
+     */
+    explicit SpectatorFeed(size_t slotCount = 4096);
+    SpectatorFeed(const SpectatorFeed&) = delete;
+    SpectatorFeed& operator=(const SpectatorFeed&) = delete;
+
+    void publish(std::string_view text); ///< Appends text to the feed. Producer thread only; never blocks.
+
+    /**
+     * @class Reader
+     * @brief One spectator's independent position in the feed.
+     */
+    class Reader {
+    public:
+        /**
+         * @brief Appends every message published since the last read.
+         * @param into Receives the text.
+         * @return How many messages were overwritten before this reader got to them.
+         */
+        uint64_t read(std::string& into);
+
+        void catchUp();      ///< Moves back to the oldest message still in the ring.
+        void skipToLatest(); ///< Drops everything unread and follows live output from now on.
+
+    private:
+        friend class SpectatorFeed;
+        Reader(const SpectatorFeed& feed, uint64_t next) : feed(&feed), next(next) {}
+
+        const SpectatorFeed* feed; ///< The feed being read.
+        uint64_t next;             ///< The number of the next message to read.
+    };
+
+    Reader subscribe() const; ///< Returns a reader that starts with the next message published.
+
+private:
+    static constexpr size_t slotWords = slotBytes / sizeof(uint64_t);
+
+    /**
+     * @struct Slot
+     * @brief One message. sequence is 2n + 1 while message n is being written and 2n + 2 once it is complete.
+     */
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence{0};                  ///< Which message the slot holds, and whether it is complete.
+        std::atomic<uint64_t> length{0};                    ///< Bytes of text in the message.
+        std::array<std::atomic<uint64_t>, slotWords> words; ///< The text, read and written a word at a time.
+    };
+
+    std::unique_ptr<Slot[]> slots; ///< The ring.
+    size_t mask;                   ///< Slot count minus one.
+    std::atomic<uint64_t> published{0}; ///< Messages published so far.
+};
+
+/**
+ * @class Spectator
+ * @brief Follows a feed on its own thread, copying it to a file as it arrives.
+ */
+class Spectator {
+public:
+    /**
+     * @brief Starts following a feed.
+     * @param feed The feed; must outlive the spectator.
+     * @param path The file to write, created or truncated; a named pipe works too.
+     * @throws std::runtime_error If the file cannot be opened.
+     */
+    Spectator(const SpectatorFeed& feed, const std::string& path);
+    ~Spectator(); ///< Drains what is left and stops the thread.
+    Spectator(const Spectator&) = delete;
+    Spectator& operator=(const Spectator&) = delete;
+
+private:
+    SpectatorFeed::Reader reader;      ///< This spectator's position in the feed.
+    std::unique_ptr<std::ostream> output; ///< Where the feed is copied.
+    std::atomic<bool> stopping{false}; ///< Tells the thread to exit.
+    std::thread thread;                ///< The reading thread.
+
+    void run(); ///< The thread's loop.
+};
+
+/**
+ * @class EventJournal
+ * @brief Append-only journal of state-changing commands, stored as compact binary records in memory-mapped segment files.
+ *
+ * Each session owns its journal, so appends are a bounds check and a memcpy into the mapped segment: no locks and no
+ * syscalls except when a full segment rolls over. A record's type byte is written last, so a reader (crash recovery
+ * or an offline analytics job) stops cleanly at the first record that was never finished.
+ */
+class EventJournal {
+public:
+    /**
+     * @enum EventType
+     * @brief The kinds of state change recorded in the journal.
+     */
+    enum class EventType : uint8_t {
+        None = 0,  ///< Unwritten space; marks the end of a segment's records.
+        Start,     ///< The session spawned at location; subject is the world's fingerprint.
+        Go,        ///< The player walked to location.
+        Teleport,  ///< The player teleported to location.
+        Portal,    ///< The player was dropped at location by Dean's portal.
+        Take,      ///< The player took the named item at location.
+        Give,      ///< The player gave the named item at location.
+        Talk,      ///< The player talked to NPC subject, advancing its message cursor.
+        Undo,      ///< The player rewound to session version subject, ending at location.
+        Tick,      ///< The world clock advanced subject seconds, firing timed events.
+        Reload     ///< The world file was reloaded; subject is the new world's fingerprint, location the player's.
+    };
+
+    /**
+     * @struct Event
+     * @brief A decoded journal record.
+     */
+    struct Event {
+        EventType type;    ///< What happened.
+        uint32_t location; ///< The location id the event happened at, or moved to.
+        uint32_t subject;  ///< The NPC id for Talk events; a version, seconds or fingerprint for others.
+        std::string name;  ///< The item name for Take and Give events.
+    };
+
+    static constexpr size_t segmentSize = 1 << 20; ///< Bytes per segment file.
+
+    EventJournal() = default;
+    ~EventJournal(); ///< Unmaps the current segment.
+    EventJournal(const EventJournal&) = delete;
+    EventJournal& operator=(const EventJournal&) = delete;
+
+    /**
+     * @brief Opens a journal directory for appending, creating it if needed.
+     * @param directory The directory holding the segment files.
+     * @throws std::runtime_error If the directory or a segment cannot be created or mapped.
+     */
+    void open(const std::string& directory);
+    bool isOpen() const; ///< Returns whether the journal is accepting appends.
+
+    /**
+     * @brief Appends one event.
+     * @param type What happened.
+     * @param location The location id the event happened at, or moved to.
+     * @param subject The NPC id for Talk events.
+     * @param name The item name for Take and Give events (truncated to 255 bytes).
+     */
+    void append(EventType type, size_t location, size_t subject = 0, std::string_view name = {});
+
+    /**
+     * @brief Reads every complete event from a journal directory without opening it for writing.
+     * @param directory The directory holding the segment files.
+     * @return The events in the order they were appended.
+     */
+    static std::vector<Event> read(const std::string& directory);
+
+    static const char* typeName(EventType type); ///< Returns a printable name for an event type.
+
+private:
+    std::string directory; ///< The directory holding the segment files.
+    int segment = -1;      ///< The index of the mapped segment, or -1 when closed.
+    int fd = -1;           ///< The file descriptor of the mapped segment.
+    char* base = nullptr;  ///< The start of the mapped segment.
+    size_t tail = 0;       ///< The offset of the next record in the mapped segment.
+
+    void mapSegment(int index); ///< Creates (if needed) and maps a segment, positioning tail after its last record.
+    void unmapSegment();        ///< Unmaps the current segment.
+    static std::string segmentPath(const std::string& directory, int index); ///< Returns the file name of a segment.
+};
+
+/**
+ * @brief Command arguments, allocated from the per-session command pool.
+ */
+using Args = std::pmr::vector<std::pmr::string>;
+
+using ItemIds = std::shared_ptr<const std::pmr::vector<uint32_t>>; ///< A sorted multiset of item ids; null when not yet recorded.
+
+/**
+ * @struct SessionState
+ * @brief One version of a session's undoable state. Versions are immutable and share every node they have in common.
+ */
+struct SessionState {
+    size_t location;                   ///< The player's location id.
+    int caloriesNeeded;                ///< Awesome points still needed.
+    int64_t pointsDelivered;           ///< Awesome points given to Dean so far.
+    PersistentArray<uint64_t> visited; ///< The discovery bitset, 64 locations per element.
+    PersistentArray<uint32_t> held;    ///< Inventory counts, by item id.
+    PersistentArray<ItemIds> placement; ///< The items in each location, by location id; null if never touched.
+};
+
+/**
+ * @class Inventory
+ * @brief Carried items, stacked by item id, with running weight and awesome-point totals.
+ *
+ * Stacks live in a dense vector and a slot table maps item ids to stacks, so adding or
+ * removing by id is O(1) and totals never need a rescan.
+ */
+class Inventory {
+public:
+    /**
+     * @struct Stack
+     * @brief Identical items held together.
+     */
+    struct Stack {
+        using allocator_type = std::pmr::polymorphic_allocator<std::byte>; ///< Lets the inventory hand its resource to the item's name.
+
+        Stack(const Item& item, uint32_t count, const allocator_type& alloc = {}) : item(item, alloc), count(count) {}
+        Stack(const Stack& other, const allocator_type& alloc) : item(other.item, alloc), count(other.count) {}
+        Stack(Stack&& other, const allocator_type& alloc) : item(std::move(other.item), alloc), count(other.count) {}
+        Stack(const Stack& other) = default;
+        Stack(Stack&& other) = default;
+        Stack& operator=(const Stack& other) = default;
+        Stack& operator=(Stack&& other) = default;
+
+        Item item;      ///< One of the stacked items.
+        uint32_t count; ///< How many are held.
+    };
+
+    /**
+     * @brief Constructs an empty inventory.
+     * @param resource The memory resource the inventory allocates from.
+     */
+    explicit Inventory(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    /**
+     * @brief Adds items, stacking them onto any held items with the same id.
+     * @param item The item; its id must be set.
+     * @param count How many to add.
+     */
+    void add(const Item& item, uint32_t count = 1);
+
+    /**
+     * @brief Removes one item by id.
+     * @param itemId The item's id.
+     * @return A copy of the removed item, or nothing if none is held.
+     */
+    std::optional<Item> remove(size_t itemId);
+
+    const Item* find(size_t itemId) const;      ///< Returns a held item by id, or nullptr.
+    uint32_t count(size_t itemId) const;        ///< Returns how many of an item are held.
+    const std::pmr::vector<Stack>& stacks() const; ///< Returns the held stacks, in no particular order.
+    bool empty() const;                         ///< Returns whether nothing is held.
+    size_t size() const;                        ///< Returns the number of items held, counting each in a stack.
+    int64_t weight() const;                     ///< Returns the total weight in hundredths of a pound.
+    int64_t points() const;                     ///< Returns the total awesome points held.
+    void clear();                               ///< Drops every item.
+
+private:
+    std::pmr::vector<Stack> held;     ///< The stacks, densely packed.
+    std::pmr::vector<uint32_t> slots; ///< Item id to stack index + 1; 0 means not held.
+    size_t itemCount = 0;             ///< Items held, counting each in a stack.
+    int64_t totalWeight = 0;          ///< Total weight in hundredths of a pound.
+    int64_t totalPoints = 0;          ///< Total awesome points.
+};
+
+/**
+ * @class Leaderboard
+ * @brief Every session in the process that saved Metalapokolips, fastest first.
+ *
+ * Entries are spread over shards by session id. Each shard is a sorted vector under its own mutex, so
+ * sessions finishing on different threads rarely contend, and queries lock one shard at a time rather
+ * than the whole board. A query therefore sees each shard as of some moment during the call.
+ */
+class Leaderboard {
+public:
+    /**
+     * @struct Entry
+     * @brief One finished session.
+     */
+    struct Entry {
+        uint64_t session;  ///< The session's id.
+        uint64_t millis;   ///< Time from the start of the session to the win.
+        uint32_t commands; ///< Commands the session ran.
+        int64_t points;    ///< Awesome points delivered to Dean.
+    };
+
+    static Leaderboard& global(); ///< Returns the process-wide board.
+
+    /**
+     * @brief Orders entries: faster first, then fewer commands, then more points.
+     * @param a An entry.
+     * @param b Another entry.
+     * @return Whether a ranks above b.
+     */
+    static bool better(const Entry& a, const Entry& b);
+
+    void record(const Entry& entry); ///< Adds a finished session, replacing an earlier entry for the same session.
+    std::vector<Entry> top(size_t count) const; ///< Returns up to count best entries, best first.
+    std::optional<size_t> rank(uint64_t session) const; ///< Returns a session's 1-based rank, or nothing if it has not finished.
+    size_t size() const; ///< Returns how many sessions have finished.
+
+private:
+    static constexpr size_t shardCount = 16; ///< Shards; a power of two comfortably above the cores sessions run on.
+
+    /**
+     * @struct Shard
+     * @brief One slice of the board, on its own cache line.
+     */
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;       ///< Guards this shard only.
+        std::vector<Entry> entries;     ///< Entries, best first.
+        std::unordered_map<uint64_t, Entry> bySession; ///< Each session's entry, for rank lookups.
+    };
+
+    std::array<Shard, shardCount> shards; ///< Every shard; a session always lands in shards[session % shardCount].
 };
 
 /**
@@ -131,34 +1334,90 @@ public:
 class Game {
 public:
     Game(); ///< Constructs a Game object and initializes the game world.
+    void watchWorld(const std::string& path, size_t residentRegions = 0); ///< Switches to a world file and reloads it whenever it changes; streams it if residentRegions is nonzero.
+    void openJournal(const std::string& directory, size_t residentRegions = 0); ///< Recovers the session from a journal directory, then journals new events to it; call before watchWorld().
+    void addSpectator(const std::string& path); ///< Mirrors the session's output to a file from a spectator thread.
+    SpectatorFeed& feed(); ///< Returns the session's output feed, for in-process spectators.
     void play(); ///< Starts the game loop.
-    void executeCommand(std::string command, std::vector<std::string> args); ///< Executes a game command.
-    void showHelp(std::vector<std::string> args); ///< Displays a list of available commands.
-    void talk(std::vector<std::string> target); ///< Allows the player to talk to an NPC.
-    void hug(std::vector<std::string> target); ///< Allows the player to kiss an NPC.
-    void take(std::vector<std::string> target); ///< Allows the player to take an item.
-    void give(std::vector<std::string> target); ///< Allows the player to give an item.
-    void go(std::vector<std::string> target); ///< Allows the player to move to a new location.
-    void look(std::vector<std::string> target); ///< Allows the player to look around the current location.
-    void quit(std::vector<std::string> target); ///< Quits the game.
-    void showInventory(std::vector<std::string> target); ///< Displays the player's inventory.
-    void teleport(std::vector<std::string> target); ///< Teleports the player to a discovered location.
-
-private:
-    std::map<std::string, std::function<void(Game*, std::vector<std::string>)>> commands; ///< A map of available commands.
-    float currentWeight; ///< The current weight of the player's inventory.
+    void runBatch(const std::pmr::vector<Args>& batch); ///< Runs a batch of commands and flushes their output once.
+    void executeCommand(std::pmr::string command, Args args); ///< Executes a game command.
+    void showHelp(Args args); ///< Displays a list of available commands.
+    void talk(Args target); ///< Allows the player to talk to an NPC.
+    void hug(Args target); ///< Allows the player to kiss an NPC.
+    void take(Args target); ///< Allows the player to take an item.
+    void give(Args target); ///< Allows the player to give an item.
+    void go(Args target); ///< Allows the player to move to a new location.
+    void look(Args target); ///< Allows the player to look around the current location.
+    void quit(Args target); ///< Quits the game.
+    void showInventory(Args target); ///< Displays the player's inventory.
+    void teleport(Args target); ///< Teleports the player to a discovered location.
+    void search(Args target); ///< Lists the locations, items and NPCs that mention some words.
+    void undo(Args target); ///< Takes back the last one or more state-changing commands.
+    void memstats(Args target); ///< Shows how much memory each subsystem holds, if tracking is on.
+    void scores(Args target); ///< Lists the fastest finishes in the process and the player's rank.
+    size_t version() const; ///< Returns the current session version; each state-changing command adds one.
+
+    /**
+     * @brief Restores the session to an earlier version, in time proportional to what changed since.
+     * @param version A version no later than version(); later versions are discarded.
+     * @throws std::out_of_range If the version does not exist.
+     */
+    void rewind(size_t version);
+
+private:
+    // Memory resources are declared first so they outlive everything allocated from them.
+    std::pmr::unsynchronized_pool_resource sessionPool{TrackingResource::get(TrackingResource::Tag::Session)}; ///< Backs per-session state such as the undo history.
+    std::pmr::unsynchronized_pool_resource inventoryPool{TrackingResource::get(TrackingResource::Tag::Inventory)}; ///< Backs the inventory.
+    std::array<std::byte, 16 * 1024> commandBuffer; ///< Fixed storage for the command pool.
+    std::pmr::monotonic_buffer_resource commandPool{commandBuffer.data(), commandBuffer.size(), TrackingResource::get(TrackingResource::Tag::IO)}; ///< Transient command buffers, released after each batch.
+
+    std::map<std::string, std::function<void(Game*, Args)>, std::less<>> commands; ///< A map of available commands.
     bool isInPotty = false; ///< Whether the player is in the Porta-Potty.
-    const int maxWeight = 50; ///< The maximum weight the player can carry.
-    std::vector<Item> inventory; ///< The player's inventory.
-    std::vector<Location> locations; ///< A list of all locations in the game.
+    const int maxWeight = 50; ///< The maximum weight the player can carry, in pounds.
+    Inventory inventory{&inventoryPool}; ///< The player's inventory.
+    std::shared_ptr<World> world; ///< The world this session plays in; kept alive by the session across reloads.
+    std::unique_ptr<WorldWatcher> watcher; ///< Rebuilds the world when its file changes; null for the built-in world.
+    std::vector<bool> visited; ///< Per-session discovery bitset, indexed by location id.
     Location* currentLocation; ///< The player's current location.
     int caloriesNeeded; ///< The number of calories (or "awesome points") needed to complete the game.
     bool inProgress; ///< Whether the game is still in progress.
+    bool batching = false; ///< Whether a multi-command batch is running (suppresses per-move renders).
+    std::chrono::steady_clock::time_point clock; ///< When the world clock last advanced.
+    std::ostringstream out; ///< Buffered output for the current batch, flushed once per input line.
+    EventJournal journal; ///< Journal of state-changing commands; closed unless openJournal() is called.
+    std::unique_ptr<SpectatorFeed> spectatorFeed; ///< Everything the session prints, for spectators; created on first use.
+    std::vector<std::unique_ptr<Spectator>> spectators; ///< Spectator threads; declared after the feed so they stop first.
+    std::pmr::vector<SessionState> history{&sessionPool}; ///< Every version since the world was adopted; back() is the current state.
+    std::pmr::unordered_map<size_t, ItemIds> originalItems{&sessionPool}; ///< Each touched location's items before the session first changed them.
+    std::pmr::vector<size_t> touchedItems{&sessionPool}; ///< Item ids whose held count the current command changed.
+    std::pmr::vector<size_t> touchedLocations{&sessionPool}; ///< Locations whose items timed events may have changed since the last commit.
+    uint64_t sessionId; ///< Identifies the session on the leaderboard.
+    std::chrono::steady_clock::time_point started; ///< When the session started, for its finish time.
+    uint32_t commandCount = 0; ///< Commands run so far.
+    int64_t pointsDelivered = 0; ///< Awesome points given to Dean so far.
+    std::string worldPath; ///< The watched world file.
+    size_t worldRegions = 0; ///< The region budget the world file, and the versions a journal replays, are streamed with.
+    std::string journalDirectory; ///< The journal directory, which also keeps each world version the journal was recorded against; empty if not journaling.
+    std::map<std::string, std::map<std::string, int>> worldChanges; ///< Per location name, per lowercase item name: how many more items the session left there than the world file places.
+    bool recovered = false; ///< Whether the session was rebuilt from a journal; its time and command count are incomplete.
     void createWorld(); ///< Initializes the game world with locations, NPCs, and items.
-    std::map<std::string, std::function<void(Game*, std::vector<std::string>)>> setup_commands(); ///< Sets up the available commands.
+    void adoptWorld(std::shared_ptr<World> next, size_t arrival = World::npos); ///< Moves the session into a new world version.
+    void advanceClock(); ///< Fires the world's timed events that came due since the last batch.
+    void finish(); ///< Records the win on the leaderboard, unless the session was recovered, and shows where it placed.
+    void printScores(size_t count); ///< Prints the best finishes and the player's rank.
+    void resetHistory(); ///< Starts a new history whose only version is the current state.
+    void recordItems(size_t location); ///< Records a location's items in the current version before a command changes them.
+    void commitState(size_t startLocation, bool amend = false); ///< Adds a version if the last command changed anything.
+    ItemIds itemsAt(size_t location); ///< Returns the ids of the items in a location, paging it in if needed.
+    std::map<std::string, std::function<void(Game*, Args)>, std::less<>> setup_commands(); ///< Sets up the available commands.
     Location* randomLocation(); ///< Returns a random location from the list of locations.
+    void replay(const std::vector<EventJournal::Event>& events); ///< Re-applies journaled events to rebuild session state.
+    std::shared_ptr<World> journaledWorld(uint32_t fingerprint); ///< Loads a world version kept in the journal directory.
     std::map<std::string, std::string> commandAliases; ///< A map of command aliases.
-    std::string toLowercase(const std::string& str); ///< Converts a string to lowercase.
+    std::pmr::string toLowercase(std::string_view str); ///< Converts a string to lowercase in the command pool.
+    std::pmr::string joinArgs(const Args& args); ///< Joins arguments with spaces in the command pool.
+    size_t findNpcHere(std::string_view name); ///< Returns the id of a named NPC or crowd archetype at the current location, or World::npos.
+    std::pmr::vector<Args> parseBatch(std::string_view input); ///< Splits an input line into commands separated by ';', or by "then" before a command word.
 };
 
 #endif
\ No newline at end of file
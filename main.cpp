@@ -6,9 +6,239 @@
 #include <vector>
 #include <algorithm>
 #include <random>
+#include <sstream>
+#include <cctype>
+#include <cmath>
+#include <memory_resource>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include <chrono>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
 
 // Ethan Bossenbroek and Asa Rowntree March 2nd, 2025
 
+namespace {
+
+/**
+ * @brief Appends a LEB128 varint.
+ * @param out The buffer to append to.
+ * @param value The value to encode.
+ */
+void putVarint(std::pmr::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+/**
+ * @brief Decodes a LEB128 varint and advances past it.
+ * @param in The read position.
+ * @return The decoded value.
+ */
+uint32_t getVarint(const uint8_t*& in) {
+    uint32_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+}
+
+} // namespace
+
+namespace {
+
+std::atomic<bool> trackingEnabled{false}; ///< Set by TrackingResource::enable().
+
+/**
+ * @brief Returns the per-tag resources. Never destroyed, so blocks freed during exit still find theirs.
+ * @return One resource per tag.
+ */
+std::array<TrackingResource, static_cast<size_t>(TrackingResource::Tag::Count)>& trackingResources() {
+    static auto* resources = new std::array<TrackingResource, static_cast<size_t>(TrackingResource::Tag::Count)>();
+    return *resources;
+}
+
+} // namespace
+
+void TrackingResource::enable() { trackingEnabled.store(true); } ///< Turns tracking on; resources taken before this stay untracked.
+bool TrackingResource::enabled() { return trackingEnabled.load(); } ///< Returns whether tracking is on.
+
+/**
+ * @brief Returns the resource a subsystem should allocate from.
+ * @param tag The subsystem.
+ * @return The tag's tracking resource if tracking is on, otherwise the new/delete resource.
+ */
+std::pmr::memory_resource* TrackingResource::get(Tag tag) {
+    if (!enabled()) return std::pmr::new_delete_resource();
+    return &trackingResources()[static_cast<size_t>(tag)];
+}
+
+/**
+ * @brief Writes one line per tag: live bytes, peak bytes, live blocks and total blocks.
+ * @param os The output stream.
+ */
+void TrackingResource::report(std::ostream& os) {
+    static const std::array<std::string_view, static_cast<size_t>(Tag::Count)> names = {
+        "world", "session", "inventory", "dialogue", "io"};
+    auto kilobytes = [](int64_t bytes) { return std::to_string((bytes + 1023) / 1024) + " KB"; };
+
+    int64_t total = 0;
+    os << "Memory held by subsystem:\n";
+    for (size_t tag = 0; tag < names.size(); ++tag) {
+        const TrackingResource& resource = trackingResources()[tag];
+        int64_t live = resource.liveBytes.load(std::memory_order_relaxed);
+        total += live;
+        os << "- " << names[tag] << ": " << kilobytes(live) << " live (peak " << kilobytes(resource.peakBytes.load(std::memory_order_relaxed))
+           << ") in " << resource.liveBlocks.load(std::memory_order_relaxed) << " blocks, "
+           << resource.totalBlocks.load(std::memory_order_relaxed) << " allocated in all\n";
+    }
+    os << "- total: " << kilobytes(total) << " live\n";
+}
+
+/**
+ * @brief Allocates from new/delete and counts the block. Relaxed atomics are enough: the counters order nothing.
+ * @param bytes The block size.
+ * @param alignment The block alignment.
+ * @return The block.
+ */
+void* TrackingResource::do_allocate(size_t bytes, size_t alignment) {
+    void* p = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    int64_t live = liveBytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) + static_cast<int64_t>(bytes);
+    int64_t peak = peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    liveBlocks.fetch_add(1, std::memory_order_relaxed);
+    totalBlocks.fetch_add(1, std::memory_order_relaxed);
+    return p;
+}
+
+/**
+ * @brief Frees a block and uncounts it.
+ * @param p The block.
+ * @param bytes The block size.
+ * @param alignment The block alignment.
+ */
+void TrackingResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    liveBytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    liveBlocks.fetch_sub(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Tracking resources are only equal to themselves, since each counts its own blocks.
+ * @param other The resource to compare with.
+ * @return Whether other is this resource.
+ */
+bool TrackingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+/**
+ * @brief Refers to encoded text inside a table.
+ * @param table The table holding the text.
+ * @param offset Byte offset of the encoded text.
+ * @param length Length of the encoded text in bytes.
+ */
+Text::Text(const TextTable& table, uint32_t offset, uint32_t length) : table(&table), offset(offset), length(length) {}
+
+bool Text::empty() const { return length == 0; } ///< Returns whether the text is empty.
+
+/**
+ * @brief Decodes the text into a string.
+ * @return The decoded text.
+ */
+std::string Text::str() const {
+    std::ostringstream os;
+    os << *this;
+    return os.str();
+}
+
+/**
+ * @brief Decodes the text straight into a stream, without building an intermediate string.
+ * @param os The output stream.
+ * @param text The text to write.
+ * @return The output stream.
+ */
+std::ostream& operator<<(std::ostream& os, const Text& text) {
+    if (text.table) text.table->write(os, text.offset, text.length);
+    return os;
+}
+
+/**
+ * @brief Constructs an empty table.
+ * @param resource The memory resource the table allocates from.
+ */
+TextTable::TextTable(std::pmr::memory_resource* resource) : ids(resource), words(resource), codes(resource) {}
+
+size_t TextTable::wordCount() const { return words.size(); } ///< Returns the number of distinct words in the dictionary.
+size_t TextTable::encodedBytes() const { return codes.size(); } ///< Returns the size of all encoded text.
+
+/**
+ * @brief Compresses text into the table.
+ * @param text The text to store.
+ * @return A handle that decodes back to exactly text.
+ */
+Text TextTable::add(std::string_view text) {
+    uint32_t offset = static_cast<uint32_t>(codes.size());
+    auto isSpace = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+
+    char buffer[256];
+    for (size_t i = 0; i < text.size(); ) {
+        // A word, or a whitespace run that isn't a single space after a word
+        size_t end = i;
+        bool space = isSpace(text[i]);
+        while (end < text.size() && isSpace(text[end]) == space) ++end;
+        bool spaceAfter = !space && end < text.size() && text[end] == ' ' && (end + 1 == text.size() || !isSpace(text[end + 1]));
+
+        std::pmr::monotonic_buffer_resource scratch(buffer, sizeof(buffer));
+        auto found = ids.find(std::pmr::string(text.substr(i, end - i), &scratch));
+        if (found == ids.end()) {
+            found = ids.emplace(std::pmr::string(text.substr(i, end - i), ids.get_allocator()), static_cast<uint32_t>(words.size())).first;
+            words.push_back(&found->first);
+        }
+
+        putVarint(codes, found->second << 1 | (spaceAfter ? 1 : 0));
+        i = end + (spaceAfter ? 1 : 0);
+    }
+    return Text(*this, offset, static_cast<uint32_t>(codes.size()) - offset);
+}
+
+/**
+ * @brief Decodes encoded text into a stream, a word at a time.
+ * @param os The output stream.
+ * @param offset Byte offset of the encoded text.
+ * @param length Length of the encoded text in bytes.
+ */
+void TextTable::write(std::ostream& os, uint32_t offset, uint32_t length) const {
+    const uint8_t* in = codes.data() + offset;
+    const uint8_t* end = in + length;
+    while (in < end) {
+        uint32_t code = getVarint(in);
+        const std::pmr::string& word = *words[code >> 1];
+        os.write(word.data(), static_cast<std::streamsize>(word.size()));
+        if (code & 1) os.put(' ');
+    }
+}
+
 /**
  * @brief Constructs an Item object.
  * @param name The name of the item.
@@ -17,213 +247,2674 @@
  * @param weight The weight of the item in pounds.
  * @throws std::invalid_argument If the name or description is empty, or if calories/weight are out of bounds.
  */
-Item::Item(const std::string& name, const std::string& description, int calories, float weight) {
+Item::Item(std::string_view name, Text description, int calories, float weight, const allocator_type& alloc)
+    : name(alloc) {
     if (name.empty()) throw std::invalid_argument("Name cannot be blank.");
     if (description.empty()) throw std::invalid_argument("Description cannot be blank.");
     if (calories < 0 || calories > 1000) throw std::invalid_argument("Calories must be between 0 and 1000.");
     if (weight < 0 || weight > 500) throw std::invalid_argument("Weight must be between 0 and 500.");
 
-    this->name = name;
-    this->description = description;
-    this->calories = calories;
-    this->weight = weight;
+    this->name = name;
+    this->description = description;
+    this->calories = calories;
+    this->weight = static_cast<int>(std::lround(weight * 100));
+}
+
+Item::Item(const Item& other, const allocator_type& alloc)
+    : name(other.name, alloc), description(other.description), calories(other.calories), weight(other.weight), id(other.id) {} ///< Copies an item into another allocator.
+
+Item::Item(Item&& other, const allocator_type& alloc)
+    : name(std::move(other.name), alloc), description(other.description), calories(other.calories), weight(other.weight), id(other.id) {} ///< Moves an item into another allocator.
+
+std::string_view Item::getName() const { return name; } ///< Returns the name of the item.
+Text Item::getDescription() const { return description; } ///< Returns the description of the item.
+int Item::getCalories() const { return calories; } ///< Returns the number of calories the item provides.
+float Item::getWeight() const { return weight / 100.0f; } ///< Returns the weight of the item in pounds.
+int Item::getWeightHundredths() const { return weight; } ///< Returns the weight of the item in hundredths of a pound.
+size_t Item::getId() const { return id; } ///< Returns the item's id in the world's item index.
+void Item::setId(size_t id) { this->id = id; } ///< Sets the item's id in the world's item index.
+
+/**
+ * @brief Overloads the << operator to print Item details.
+ * @param os The output stream.
+ * @param item The Item object to print.
+ * @return The output stream.
+ */
+std::ostream& operator<<(std::ostream& os, const Item& item) {
+    os << item.name << " (" << item.calories << " awesome points)- " << item.getWeight() << " lb- " << item.description;
+    return os;
+}
+
+/**
+ * @brief Constructs an empty arena.
+ * @param resource The memory resource the arena's buffer is allocated from.
+ */
+DialogueArena::DialogueArena(std::pmr::memory_resource* resource) : text(resource) {}
+
+/**
+ * @brief Appends a message to the arena.
+ * @param message The message text.
+ * @return The span addressing the message inside the arena.
+ */
+DialogueArena::Span DialogueArena::add(std::string_view message) {
+    Span span{static_cast<uint32_t>(text.size()), static_cast<uint32_t>(message.size())};
+    text += message;
+    return span;
+}
+
+/**
+ * @brief Returns a view of a message stored in the arena.
+ * @param span The span returned by add().
+ * @return A view into the arena; valid until the arena is destroyed or grows.
+ */
+std::string_view DialogueArena::get(Span span) const {
+    return std::string_view(text.data() + span.offset, span.length);
+}
+
+size_t DialogueArena::size() const { return text.size(); } ///< Returns the number of bytes of dialogue stored.
+
+/**
+ * @brief Constructs an NPC object.
+ * @param name The name of the NPC.
+ * @param description A description of the NPC.
+ * @param dialogue The arena the NPC's messages are stored in.
+ * @param alloc The allocator the NPC's members are allocated from.
+ * @throws std::invalid_argument If the name or description is empty.
+ */
+NPC::NPC(std::string_view name, Text description, DialogueArena& dialogue, const allocator_type& alloc)
+    : name(alloc), messages(alloc) {
+    if (name.empty() || description.empty()) {
+        throw std::invalid_argument("Name and description cannot be blank.");
+    }
+
+    this->name = name;
+    this->description = description;
+    this->dialogue = &dialogue;
+    this->messageNumber = 0;
+    this->id = 0;
+}
+
+NPC::NPC(const NPC& other, const allocator_type& alloc)
+    : name(other.name, alloc), description(other.description), dialogue(other.dialogue),
+      messages(other.messages, alloc), messageNumber(other.messageNumber), id(other.id) {} ///< Copies an NPC into another allocator.
+
+NPC::NPC(NPC&& other, const allocator_type& alloc)
+    : name(std::move(other.name), alloc), description(other.description), dialogue(other.dialogue),
+      messages(std::move(other.messages), alloc), messageNumber(other.messageNumber), id(other.id) {} ///< Moves an NPC into another allocator.
+
+std::string_view NPC::getName() const { return name; } ///< Returns the name of the NPC.
+Text NPC::getDescription() const { return description; } ///< Returns the description of the NPC.
+size_t NPC::getId() const { return id; } ///< Returns the NPC's index in the world's NPC table.
+void NPC::setId(size_t id) { this->id = id; } ///< Sets the NPC's index in the world's NPC table.
+
+void NPC::addMessage(std::string_view message) { messages.push_back(dialogue->add(message)); } ///< Adds a message to the NPC's list of messages.
+void NPC::addMessage(DialogueArena::Span message) { messages.push_back(message); } ///< Adds a message already stored in the dialogue arena.
+
+/**
+ * @brief Returns the next message in the NPC's list.
+ * @return A view of the next message in the dialogue arena.
+ */
+size_t NPC::getMessageNumber() const { return messageNumber; } ///< Returns the index of the next message to display.
+void NPC::setMessageNumber(size_t number) { messageNumber = messages.empty() ? 0 : number % messages.size(); } ///< Sets the next message to display.
+
+std::string_view NPC::getMessage() {
+    if (messages.empty()) {
+        return "This NPC has no messages.";
+    }
+    std::string_view message = dialogue->get(messages[messageNumber]);
+    messageNumber = (messageNumber + 1) % messages.size();
+    return message;
+}
+
+/**
+ * @brief Overloads the << operator to print the NPC's name.
+ * @param os The output stream.
+ * @param npc The NPC object to print.
+ * @return The output stream.
+ */
+std::ostream& operator<<(std::ostream& os, const NPC& npc) {
+    os << npc.name;
+    return os;
+}
+
+/**
+ * @brief Constructs a Location object.
+ * @param name The name of the location.
+ * @param description A description of the location.
+ * @param alloc The allocator the location's members are allocated from.
+ * @throws std::invalid_argument If the name is empty.
+ */
+Location::Location(std::string_view name, Text description, const allocator_type& alloc)
+    : name(alloc), npcs(alloc), items(alloc), neighbors(alloc) {
+    if (name.empty()) throw std::invalid_argument("Name cannot be blank.");
+    this->name = name;
+    this->description = description;
+    this->id = 0;
+}
+
+Location::Location(const Location& other, const allocator_type& alloc)
+    : name(other.name, alloc), description(other.description), npcs(other.npcs, alloc),
+      items(other.items, alloc), id(other.id), neighbors(other.neighbors, alloc) {} ///< Copies a location into another allocator.
+
+Location::Location(Location&& other, const allocator_type& alloc)
+    : name(std::move(other.name), alloc), description(other.description), npcs(std::move(other.npcs), alloc),
+      items(std::move(other.items), alloc), id(other.id), neighbors(std::move(other.neighbors), alloc) {} ///< Moves a location into another allocator.
+
+std::string_view Location::getName() const { return name; } ///< Returns the name of the location.
+Text Location::getDescription() const { return description; } ///< Returns the description of the location.
+void Location::setDescription(Text description) { this->description = description; } ///< Replaces the description.
+size_t Location::getId() const { return id; } ///< Returns the location's index in the world.
+void Location::setId(size_t id) { this->id = id; } ///< Sets the location's index in the world.
+
+const std::pmr::map<std::pmr::string, Location*>& Location::get_locations() const { return neighbors; } ///< Returns the map of neighboring locations.
+
+/**
+ * @brief Adds a neighboring location.
+ * @param direction The direction of the neighboring location.
+ * @param location A pointer to the neighboring location.
+ * @throws std::invalid_argument If the direction is empty or already mapped.
+ */
+void Location::add_location(std::string_view direction, Location* location) {
+    if (direction.empty()) {
+        throw std::invalid_argument("Direction cannot be empty.");
+    }
+    if (!neighbors.emplace(direction, location).second) {
+        throw std::invalid_argument("That direction is already mapped for this location.");
+    }
+}
+
+void Location::add_npc(size_t npcId) { npcs.push_back(npcId); } ///< Places an NPC, by id, in the location.
+const std::pmr::vector<size_t>& Location::get_npcs() const { return npcs; } ///< Returns the ids of the NPCs in the location.
+void Location::add_item(const Item& item) { items.push_back(item); } ///< Adds an item to the location.
+
+/**
+ * @brief Builds an item directly in the location's allocator, avoiding a temporary.
+ * @param name The name of the item.
+ * @param description A description of the item.
+ * @param calories The number of calories the item provides.
+ * @param weight The weight of the item in pounds.
+ * @return The new item.
+ */
+Item& Location::emplace_item(std::string_view name, Text description, int calories, float weight) {
+    return items.emplace_back(name, description, calories, weight);
+}
+
+/**
+ * @brief Removes an item from the location.
+ * @param item The item to remove.
+ */
+void Location::remove_item(const Item& item) {
+    auto it = std::find_if(items.begin(), items.end(),
+        [&item](const Item& i) { return i.getName() == item.getName(); });
+    if (it != items.end()) {
+        items.erase(it);
+    }
+}
+
+/**
+ * @brief Removes every item and returns their storage to the allocator.
+ */
+void Location::clear_items() {
+    items.clear();
+    items.shrink_to_fit();
+}
+
+const std::pmr::vector<Item>& Location::get_items() const { return items; } ///< Returns the list of items in the location.
+
+/**
+ * @brief Prints Location details, labelling neighbors from a session's discovery bitset.
+ * @param os The output stream.
+ * @param world The world the location belongs to, for its NPC table and crowds.
+ * @param visited The visited bitset, indexed by location id.
+ * @return The output stream.
+ */
+std::ostream& Location::print(std::ostream& os, const World& world, const std::vector<bool>& visited) const {
+    const Location& location = *this;
+
+    // Location name and description
+    os << location.name << "- " << location.description << "\n\n";
+
+    // List NPCs
+    os << "You see the following NPCs:\n";
+    std::vector<std::pair<size_t, size_t>> groups = world.crowd.groupsAt(id);
+    if (location.npcs.empty() && groups.empty()) {
+        os << "- None\n";
+    } else {
+        for (size_t npcId : location.npcs) {
+            const NPC& npc = world.npcs[npcId];
+            os << "- " << npc.getName() << ":" << npc.getDescription() << "\n";
+        }
+        for (const auto& group : groups) {
+            const NPC& npc = world.npcs[group.first];
+            os << "- " << npc.getName() << " (x" << group.second << "):" << npc.getDescription() << "\n";
+        }
+    }
+
+    // List items
+    os << "\nYou see the following Items:\n";
+    if (location.items.empty()) {
+        os << "- None\n";
+    } else {
+        for (const Item& item : location.items) {
+            os << "- " << item.getName() << " (" << item.getCalories() << " awesome points) - "
+               << item.getWeight() << " lb- " << item.getDescription() << "\n";
+        }
+    }
+
+    // List directions
+    os << "\nYou can go in the following Directions:\n";
+    if (location.neighbors.empty()) {
+        os << "- None\n";
+    } else {
+        for (const auto& neighbor : location.neighbors) {
+            size_t id = neighbor.second->id;
+            bool seen = id < visited.size() && visited[id];
+            os << "- " << neighbor.first << "- "
+               << (seen ? neighbor.second->name : "Unknown")
+               << (seen ? " (Visited)" : "") << "\n";
+        }
+    }
+
+    return os;
+}
+
+namespace {
+
+/**
+ * @brief The festival shipped with the game, in world-file format (see World).
+ */
+const char* const builtInWorld = R"WORLD(
+# Locations
+location Main Stage | The heart of the festival, a colossal stage towering over the crowd. Flames erupt from the stage as the band rips into a brutal breakdown.
+location Second Stage | A slightly smaller stage, but still packed with energy. The air smells like sweat, beer, and distortion pedals cranked to 11.
+location Third Stage | A more underground stage, featuring extreme metal bands. The pit here is absolute chaos.
+location VIP Lounge | An exclusive area behind the main stage. You hear whispers of legendary rockstars hanging out here.
+location Porta-Potty Row | A long line of overused porta-potties. The air is thick with regret.
+location Porta-Potty | Ew it stinks, and a carving on the wall says: *try down* weird.
+location Founders Beer Tent | A massive beer tent, offering legendary brews. It’s crowded, but the drinks are worth it.
+location Three Floyds Beer Tent | Another beer tent, home to Zombie Dust and more. You overhear someone say, 'Best beer at the fest!'
+location Merch Booths | A row of tents selling band shirts, records, and obscure patches. You spot a rare vinyl you’ve been hunting for years.
+location Food Court | A collection of food trucks selling everything from greasy festival burgers to vegan burritos.
+location Medical Tent | A small white tent with a red cross. Someone inside is getting their wounds patched up from a wild mosh pit.
+location Camping Grounds | A sea of tents and campfires, where festival-goers rest between sets. Smells like beer, weed, and cheap ramen.
+location Parking Lot | A large open area filled with cars. It’s noisy and smells like gasoline. Why did you come here?
+location Hell | You’ve somehow found yourself in Hell. But wait, is that Dimebag Darrell shredding in the distance?
+
+# NPCs
+
+npc Dean | Dean Zelinsky, a legendary luthier some even say he has powers.
+say Dean | I need quality parts to build the ultimate axe!
+say Dean | That's the stuff! Keep 'em coming!
+say Dean | One more piece and this baby will scream!
+place Dean | VIP Lounge
+
+npc Sound Engineer | A stressed-looking guy adjusting the mix.
+say Sound Engineer | If you mess with my soundboard, I swear to Dio…
+say Sound Engineer | This mix is the difference between a killer set and total disaster.
+place Sound Engineer | Main Stage
+
+npc Security Guard | A no-nonsense security guard scanning the crowd.
+say Security Guard | Keep it safe, but go hard.
+say Security Guard | No crowd surfing past the barricade!
+place Security Guard | Founders Beer Tent
+
+npc Roadie | A rugged roadie moving amps.
+say Roadie | You think this job is easy? Load in at 6 AM, load out at 2 AM.
+say Roadie | We run this festival, not the bands.
+place Roadie | Second Stage
+
+npc Beer Vendor | A cheerful vendor pouring pints.
+say Beer Vendor | One sip of this, and you'll be ready for the next set!
+say Beer Vendor | We ran out of IPA? Damn, that was fast.
+say Beer Vendor | *mumbling* I love my job.
+place Beer Vendor | Founders Beer Tent
+place Beer Vendor | Three Floyds Beer Tent
+
+# Metal legends in the VIP Lounge
+npc Ozzy Osbourne | The Prince of Darkness himself, sipping a drink in the VIP Lounge.
+say Ozzy Osbourne | Sharon! Where’s my bloody bat?!
+say Ozzy Osbourne | Metal ain't dead, mate. Just evolving.
+place Ozzy Osbourne | VIP Lounge
+
+npc Lemmy Kilmister | The legendary Motörhead frontman, playing a slot machine in the corner.
+say Lemmy Kilmister | If you think you’re too old for rock and roll, then you are.
+say Lemmy Kilmister | Ace of Spades, mate! That’s the only song you need.
+place Lemmy Kilmister | VIP Lounge
+
+npc Dimebag Darrell | A ghostly presence, now a true Cowboy of Hell.
+say Dimebag Darrell | Dude, you made it to Hell? That’s METAL!
+say Dimebag Darrell | I got riffs that’d melt your face off. Want a lesson?
+place Dimebag Darrell | Hell
+
+npc Eddie Van Halen | A ghostly presence, shredding in the fires of Hell.
+say Eddie Van Halen | What's up dude.
+say Eddie Van Halen | Wanna come try my rig?
+place Eddie Van Halen | Hell
+
+npc Ronnie James Dio | The master of metal, throwing up the horns.
+say Ronnie James Dio | We are the last in line! Don’t forget that.
+say Ronnie James Dio | Man, Heaven and Hell still holds up!
+place Ronnie James Dio | Hell
+
+# Guitar parts
+
+item Merch Booths | Neck | Maple guitar neck with rosewood fretboard | 50 | 4.2
+item Second Stage | Body | Solid mahogany body with flame top | 60 | 8.5
+item Main Stage | Pickups | High-output humbuckers with coil tapping | 45 | 1.8
+item VIP Lounge | Tuners | Locking machine heads for perfect tuning | 50 | 0.9
+item Three Floyds Beer Tent | Strings | Heavy gauge nickel-wound strings | 45 | 0.3
+item Camping Grounds | Floyd Rose | Professional tremolo system | 65 | 2.1
+item Third Stage | Bridge | Fixed bridge for enhanced sustain | 55 | 2.0
+item Hell | Pickguard | Classic black pickguard | 40 | 0.5
+item Main Stage | Nut | Lol, Bone nut for better tone and sustain | 30 | 0.1
+item Second Stage | Truss Rod | Adjustable truss rod for neck stability | 35 | 0.3
+item Third Stage | Volume Knob | Gold-plated volume knob, a little dusty | 35 | 0.2
+item VIP Lounge | Tone Knob | Gold-plated tone knob actually kinda cool | 40 | 0.2
+item Three Floyds Beer Tent | Output Jack | High-quality 1/4-inch output jack | 30 | 0.1
+item Merch Booths | Strap Buttons | Secure locking strap buttons | 25 | 0.2
+item Camping Grounds | Capacitor | Orange drop capacitor for tone control | 30 | 0.05
+item Hell | Dime's Floyd | The Floyd Rose used by the goat himself | 120 | 0.15
+item Hell | Hell Pickup | Hand wound by EVH himself, this thing roars | 150 | 0.15
+
+# beers
+item Three Floyds Beer Tent | Gumballhead | Delicious Pale Ale, cost you $18, but frankly, who's surprised | 0 | 0.15
+item Three Floyds Beer Tent | Zombie Dust | Hellishly Hoppy IPA, cost you $93, awesome! | 0 | 0.15
+item Founders Beer Tent | Mortal Bloom | Quencing IPA, cost you $400, tastes floral and citrusy | 0 | 0.15
+item Founders Beer Tent | All Day IPA | Drinkable and Crisp, cost you $3.47, totally crushable | 0 | 0.15
+
+# Main Stage
+exit Main Stage | north | VIP Lounge
+exit Main Stage | south | Food Court
+exit Main Stage | east | Second Stage
+exit Main Stage | west | Third Stage
+
+# Second Stage
+exit Second Stage | west | Main Stage
+exit Second Stage | east | Founders Beer Tent
+
+# Third Stage
+exit Third Stage | east | Main Stage
+exit Third Stage | west | Three Floyds Beer Tent
+
+# VIP Lounge
+exit VIP Lounge | south | Main Stage
+
+# Food Court
+exit Food Court | north | Main Stage
+exit Food Court | south | Medical Tent
+exit Food Court | east | Founders Beer Tent
+exit Food Court | west | Three Floyds Beer Tent
+exit Food Court | northeast | Merch Booths
+exit Food Court | northwest | Porta-Potty Row
+
+# Porta-Potty Row
+exit Porta-Potty Row | southeast | Food Court
+exit Porta-Potty Row | enter | Porta-Potty
+
+# Porta-Potty
+exit Porta-Potty | down | Hell
+
+# Medical Tent
+exit Medical Tent | north | Food Court
+exit Medical Tent | south | Camping Grounds
+
+# Camping Grounds
+exit Camping Grounds | north | Medical Tent
+exit Camping Grounds | east | Parking Lot
+
+# Parking Lot
+exit Parking Lot | west | Camping Grounds
+
+# Beer Tent Connections
+exit Founders Beer Tent | west | Food Court
+exit Three Floyds Beer Tent | east | Food Court
+
+# Merch Booths
+exit Merch Booths | southwest | Food Court
+
+# portal out of hell into vip lounge
+exit Hell | north | VIP Lounge
+
+# Crowds
+npc Headbanger | A sweaty fan in a battle vest, neck already sore.
+say Headbanger | Did you see that circle pit?!
+say Headbanger | I've been here since the gates opened. No regrets.
+npc Festival-goer | Somebody in a band shirt looking for their friends.
+say Festival-goer | Have you seen a guy in a Slayer shirt? ...Never mind, that's everyone.
+say Festival-goer | Food Court burritos are a trap. Trust me.
+crowd Headbanger | 120 | Camping Grounds | seek | Main Stage
+crowd Headbanger | 60 | Parking Lot | seek | Third Stage
+crowd Festival-goer | 150 | Food Court | wander
+avoid Hell
+
+# Timed events
+every 90 | respawn | Three Floyds Beer Tent | Zombie Dust
+every 120 | respawn | Founders Beer Tent | All Day IPA
+every 45 | toggle | Porta-Potty Row | enter
+at 600 | say | Sound Engineer | Headliner's up next. If the PA dies now, we're all dead.
+at 900 | say | Roadie | Stage set's changing. Watch your toes or lose 'em.
+)WORLD";
+
+/**
+ * @brief Trims spaces and tabs from both ends of a string.
+ * @param str The string to trim.
+ * @return A view of the trimmed string.
+ */
+std::string_view trim(std::string_view str) {
+    size_t start = str.find_first_not_of(" \t\r");
+    if (start == std::string_view::npos) return {};
+    size_t end = str.find_last_not_of(" \t\r");
+    return str.substr(start, end - start + 1);
+}
+
+/**
+ * @brief Splits a world-file field list on '|', trimming each field.
+ * @param str The text after the directive.
+ * @return The fields.
+ */
+std::vector<std::string_view> splitFields(std::string_view str) {
+    std::vector<std::string_view> fields;
+    size_t start = 0;
+    while (true) {
+        size_t bar = str.find('|', start);
+        fields.push_back(trim(str.substr(start, bar == std::string_view::npos ? std::string_view::npos : bar - start)));
+        if (bar == std::string_view::npos) break;
+        start = bar + 1;
+    }
+    return fields;
+}
+
+/**
+ * @brief Looks up a lowercase key in a name index without touching the heap.
+ * @param index The index to search.
+ * @param name The name to look up, in any case.
+ * @return The mapped id, or World::npos.
+ */
+size_t lookup(const std::pmr::unordered_map<std::pmr::string, size_t>& index, std::string_view name) {
+    char buffer[256];
+    std::pmr::monotonic_buffer_resource scratch(buffer, sizeof(buffer));
+    std::pmr::string key(name, &scratch);
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+    auto it = index.find(key);
+    return it == index.end() ? World::npos : it->second;
+}
+
+/**
+ * @brief Compares two strings case-insensitively without allocating.
+ * @param a The first string.
+ * @param b The second string.
+ * @return Whether the strings are equal ignoring case.
+ */
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+        [](char x, char y) { return ::tolower(static_cast<unsigned char>(x)) == ::tolower(static_cast<unsigned char>(y)); });
+}
+
+/**
+ * @brief Splits text into search terms: lowercase runs of letters and digits, at least two long.
+ * @param text The text to split.
+ * @param terms Receives the terms; cleared first so callers can reuse it.
+ */
+void splitTerms(std::string_view text, std::vector<std::string>& terms) {
+    terms.clear();
+    std::string term;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        unsigned char c = i < text.size() ? static_cast<unsigned char>(text[i]) : ' ';
+        if (std::isalnum(c)) {
+            term += static_cast<char>(::tolower(c));
+        } else if (c != '\'') { // "Hetfield's" indexes as "hetfields"
+            if (term.size() > 1) terms.push_back(term);
+            term.clear();
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Adds members to the crowd.
+ * @param archetypeId The NPC id the members are instances of.
+ * @param count How many members to add.
+ * @param location Where they start.
+ * @param how How they move.
+ * @param targetLocation The location Seek members head for.
+ */
+void Crowd::add(size_t archetypeId, size_t count, size_t location, Rule how, size_t targetLocation) {
+    uint32_t slot = 0;
+    if (how == Rule::Seek) {
+        auto it = std::find(targets.begin(), targets.end(), targetLocation);
+        slot = static_cast<uint32_t>(it - targets.begin());
+        if (it == targets.end()) targets.push_back(static_cast<uint32_t>(targetLocation));
+        graphDirty = true;
+    }
+
+    size_t size = position.size() + count;
+    position.resize(size, static_cast<uint32_t>(location));
+    archetype.resize(size, static_cast<uint32_t>(archetypeId));
+    target.resize(size, slot);
+    rule.resize(size, how);
+    while (seed.size() < size) {
+        seed.push_back(static_cast<uint32_t>(seed.size() + 1) * 2654435761u | 1); // xorshift needs a nonzero state
+    }
+}
+
+void Crowd::avoid(size_t location) { avoided.push_back(static_cast<uint32_t>(location)); graphDirty = true; } ///< Makes members leave a location whenever they end up there.
+void Crowd::markGraphDirty() { graphDirty = true; } ///< Notes that exits changed, so paths are recomputed on the next step.
+size_t Crowd::size() const { return position.size(); } ///< Returns the number of members.
+
+/**
+ * @brief Snapshots the locations' exits and builds the index without moving anyone.
+ * @param locations The world's locations.
+ */
+void Crowd::settle(const std::pmr::vector<Location>& locations) {
+    rebuildGraph(locations);
+    rebuildIndex(locations.size());
+}
+
+/**
+ * @brief Moves every member one step and rebuilds the per-location index.
+ * @param locations The world's locations, for their exits.
+ */
+void Crowd::step(const std::pmr::vector<Location>& locations) {
+    if (graphDirty || edgeStart.size() != locations.size() + 1) {
+        rebuildGraph(locations);
+    }
+
+    // Members are independent, so big crowds split into contiguous chunks, one per thread
+    constexpr size_t minChunk = 1 << 16;
+    size_t count = position.size();
+    size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count / minChunk);
+    if (threads <= 1) {
+        move(0, count, locations.size());
+    } else {
+        std::vector<std::thread> workers;
+        size_t chunk = (count + threads - 1) / threads;
+        for (size_t begin = 0; begin < count; begin += chunk) {
+            workers.emplace_back(&Crowd::move, this, begin, std::min(count, begin + chunk), locations.size());
+        }
+        for (auto& worker : workers) worker.join();
+    }
+
+    rebuildIndex(locations.size());
+}
+
+/**
+ * @brief Steps members [begin, end). Touches only those members' entries, so chunks can run in parallel.
+ * @param begin The first member.
+ * @param end One past the last member.
+ * @param locationCount The number of locations.
+ */
+void Crowd::move(size_t begin, size_t end, size_t locationCount) {
+    const uint32_t* starts = edgeStart.data();
+    const uint32_t* exits = edges.data();
+    const uint32_t* hops = nextHop.data();
+    const uint32_t* away = escape.data();
+
+    for (size_t i = begin; i < end; ++i) {
+        uint32_t here = position[i];
+
+        uint32_t x = seed[i];
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        seed[i] = x;
+
+        uint32_t degree = starts[here + 1] - starts[here];
+        uint32_t pick = x % (degree + 1); // degree + 1 so wanderers sometimes stay
+        uint32_t wander = pick < degree ? exits[starts[here] + pick] : here;
+        // Only seekers have next-hop rows; a world of wanderers has none at all
+        uint32_t next = rule[i] == Rule::Seek ? hops[target[i] * locationCount + here] : wander;
+
+        position[i] = away[here] != here ? away[here] : next;
+    }
+}
+
+/**
+ * @brief Snapshots exits in CSR form and recomputes escape routes and next hops toward every Seek target.
+ * @param locations The world's locations.
+ */
+void Crowd::rebuildGraph(const std::pmr::vector<Location>& locations) {
+    size_t count = locations.size();
+
+    edgeStart.assign(count + 1, 0);
+    edges.clear();
+    for (size_t v = 0; v < count; ++v) {
+        for (const auto& neighbor : locations[v].neighbors) {
+            edges.push_back(static_cast<uint32_t>(neighbor.second->getId()));
+        }
+        edgeStart[v + 1] = static_cast<uint32_t>(edges.size());
+    }
+
+    // Reverse edges, for searching backwards from each target
+    std::vector<uint32_t> reverseStart(count + 1, 0), reverse(edges.size());
+    for (uint32_t to : edges) ++reverseStart[to + 1];
+    for (size_t v = 0; v < count; ++v) reverseStart[v + 1] += reverseStart[v];
+    std::vector<uint32_t> cursor(reverseStart.begin(), reverseStart.end() - 1);
+    for (size_t v = 0; v < count; ++v) {
+        for (uint32_t e = edgeStart[v]; e < edgeStart[v + 1]; ++e) reverse[cursor[edges[e]]++] = static_cast<uint32_t>(v);
+    }
+
+    nextHop.assign(targets.size() * count, 0);
+    std::vector<uint32_t> distance(count);
+    std::vector<uint32_t> queue;
+    for (size_t slot = 0; slot < targets.size(); ++slot) {
+        std::fill(distance.begin(), distance.end(), UINT32_MAX);
+        queue.assign(1, targets[slot]);
+        distance[targets[slot]] = 0;
+        for (size_t head = 0; head < queue.size(); ++head) {
+            uint32_t v = queue[head];
+            for (uint32_t e = reverseStart[v]; e < reverseStart[v + 1]; ++e) {
+                if (distance[reverse[e]] == UINT32_MAX) {
+                    distance[reverse[e]] = distance[v] + 1;
+                    queue.push_back(reverse[e]);
+                }
+            }
+        }
+
+        uint32_t* hops = nextHop.data() + slot * count;
+        for (size_t v = 0; v < count; ++v) {
+            hops[v] = static_cast<uint32_t>(v);
+            if (distance[v] == UINT32_MAX || distance[v] == 0) continue;
+            for (uint32_t e = edgeStart[v]; e < edgeStart[v + 1]; ++e) {
+                if (distance[edges[e]] + 1 == distance[v]) {
+                    hops[v] = edges[e];
+                    break;
+                }
+            }
+        }
+    }
+
+    std::vector<bool> isAvoided(count, false);
+    for (uint32_t v : avoided) isAvoided[v] = true;
+    escape.resize(count);
+    for (size_t v = 0; v < count; ++v) {
+        escape[v] = static_cast<uint32_t>(v);
+        if (!isAvoided[v]) continue;
+        for (uint32_t e = edgeStart[v]; e < edgeStart[v + 1]; ++e) {
+            if (!isAvoided[edges[e]]) {
+                escape[v] = edges[e];
+                break;
+            }
+        }
+    }
+
+    graphDirty = false;
+}
+
+/**
+ * @brief Regroups members by location with a counting sort, so look/talk read one contiguous range per location.
+ * @param locationCount The number of locations.
+ */
+void Crowd::rebuildIndex(size_t locationCount) {
+    memberStart.assign(locationCount + 1, 0);
+    for (uint32_t p : position) ++memberStart[p + 1];
+    for (size_t v = 0; v < locationCount; ++v) memberStart[v + 1] += memberStart[v];
+
+    members.resize(position.size());
+    std::vector<uint32_t> cursor(memberStart.begin(), memberStart.end() - 1);
+    for (size_t i = 0; i < position.size(); ++i) {
+        members[cursor[position[i]]++] = static_cast<uint32_t>(i);
+    }
+}
+
+/**
+ * @brief Counts members of each archetype at a location.
+ * @param location The location id.
+ * @return Archetype NPC id and member count pairs, in archetype order.
+ */
+std::vector<std::pair<size_t, size_t>> Crowd::groupsAt(size_t location) const {
+    std::vector<std::pair<size_t, size_t>> groups;
+    if (location + 1 >= memberStart.size()) return groups;
+
+    std::map<size_t, size_t> counts;
+    for (uint32_t m = memberStart[location]; m < memberStart[location + 1]; ++m) {
+        ++counts[archetype[members[m]]];
+    }
+    groups.assign(counts.begin(), counts.end());
+    return groups;
+}
+
+/**
+ * @brief Returns how many members of an archetype are at a location.
+ * @param location The location id.
+ * @param archetypeId The NPC id.
+ * @return The member count.
+ */
+size_t Crowd::countAt(size_t location, size_t archetypeId) const {
+    if (location + 1 >= memberStart.size()) return 0;
+    return std::count_if(members.begin() + memberStart[location], members.begin() + memberStart[location + 1],
+        [&](uint32_t m) { return archetype[m] == archetypeId; });
+}
+
+/**
+ * @brief Builds an empty index.
+ * @param resource The resource the index allocates from.
+ */
+SearchIndex::SearchIndex(std::pmr::memory_resource* resource)
+    : names(resource), documents(resource), terms(resource), postings(resource) {}
+
+size_t SearchIndex::documentCount() const { return documents.size(); } ///< Returns the number of indexed documents.
+size_t SearchIndex::postingBytes() const { return postings.size(); } ///< Returns the size of the compressed posting lists.
+
+/**
+ * @brief Indexes one document, counting each name term three times so names outrank passing mentions.
+ * @param kind What the document describes.
+ * @param id The location or NPC id the document refers to.
+ * @param name The document's name.
+ * @param text The document's description.
+ */
+void SearchIndex::add(Kind kind, size_t id, std::string_view name, std::string_view text) {
+    constexpr uint32_t nameWeight = 3;
+    uint32_t document = static_cast<uint32_t>(documents.size());
+    documents.push_back({kind, static_cast<uint32_t>(id), names.add(name)});
+
+    static thread_local std::vector<std::string> words;
+    std::vector<std::pair<std::string, uint32_t>> counts;
+    splitTerms(name, words);
+    for (auto& word : words) counts.emplace_back(std::move(word), nameWeight);
+    splitTerms(text, words);
+    for (auto& word : words) counts.emplace_back(std::move(word), 1);
+
+    std::sort(counts.begin(), counts.end());
+    for (size_t i = 0; i < counts.size(); ) {
+        uint32_t frequency = 0;
+        size_t j = i;
+        for (; j < counts.size() && counts[j].first == counts[i].first; ++j) frequency += counts[j].second;
+
+        std::pmr::vector<uint32_t>& raw = building.try_emplace(std::pmr::string(counts[i].first, building.get_allocator())).first->second;
+        raw.push_back(document);
+        raw.push_back(frequency);
+        i = j;
+    }
+}
+
+/**
+ * @brief Encodes each term's postings as varint document gaps and frequencies, then frees the raw lists.
+ *
+ * The encoding grows on the heap and is copied into the index's resource once, at its final size, since an arena
+ * never gets back the blocks a growing vector leaves behind.
+ */
+void SearchIndex::finish() {
+    std::pmr::vector<uint8_t> encoded(std::pmr::get_default_resource());
+    terms.reserve(building.size());
+    for (auto& [term, raw] : building) {
+        Postings list{static_cast<uint32_t>(postings.size() + encoded.size()), 0, static_cast<uint32_t>(raw.size() / 2)};
+        uint32_t previous = 0;
+        for (size_t i = 0; i < raw.size(); i += 2) {
+            putVarint(encoded, raw[i] - previous); // documents are added in order, so gaps are never negative
+            putVarint(encoded, raw[i + 1]);
+            previous = raw[i];
+        }
+        list.bytes = static_cast<uint32_t>(postings.size() + encoded.size()) - list.offset;
+        terms.emplace(term, list);
+    }
+    building.clear();
+    building.rehash(0);
+    postings.insert(postings.end(), encoded.begin(), encoded.end());
+}
+
+/**
+ * @brief Finds the documents that best match a query.
+ * @param query Words to look for, in any case.
+ * @param limit The most hits to return.
+ * @return Hits ranked by matched terms, then tf-idf score.
+ */
+std::vector<SearchIndex::Hit> SearchIndex::find(std::string_view query, size_t limit) const {
+    std::vector<std::string> words;
+    splitTerms(query, words);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    std::unordered_map<uint32_t, std::pair<size_t, double>> scores;
+    char buffer[256];
+    std::pmr::monotonic_buffer_resource scratch(buffer, sizeof(buffer));
+    for (const auto& word : words) {
+        auto it = terms.find(std::pmr::string(word, &scratch));
+        if (it == terms.end()) continue;
+
+        const Postings& list = it->second;
+        double idf = std::log(1.0 + static_cast<double>(documents.size()) / list.documents);
+        const uint8_t* in = postings.data() + list.offset;
+        const uint8_t* end = in + list.bytes;
+        for (uint32_t document = 0; in < end; ) {
+            document += getVarint(in);
+            uint32_t frequency = getVarint(in);
+            auto& entry = scores[document];
+            entry.first += 1;
+            entry.second += (1.0 + std::log(static_cast<double>(frequency))) * idf;
+        }
+    }
+
+    std::vector<Hit> hits;
+    hits.reserve(scores.size());
+    for (const auto& [document, score] : scores) {
+        const Document& doc = documents[document];
+        hits.push_back({doc.kind, doc.id, names.get(doc.name), score.first, score.second});
+    }
+    auto better = [](const Hit& a, const Hit& b) {
+        return a.matched != b.matched ? a.matched > b.matched : a.score > b.score;
+    };
+    size_t kept = std::min(limit, hits.size());
+    std::partial_sort(hits.begin(), hits.begin() + kept, hits.end(), better);
+    hits.resize(kept);
+    return hits;
+}
+
+/**
+ * @brief Opens an empty store backed by an anonymous temporary file.
+ * @param locationCount How many locations the world has.
+ * @param budget How many regions may be resident at once; raised to 2 so a move across a border never evicts its origin.
+ * @throws std::runtime_error If the spill file cannot be created.
+ */
+RegionStore::RegionStore(size_t locationCount, size_t budget)
+    : spill(std::tmpfile()), regions((locationCount + regionSize - 1) / regionSize),
+      maxResident(std::max<size_t>(2, budget)), locationCount(locationCount), loading(World::npos) {
+    if (!spill) throw std::runtime_error("Cannot create the region spill file");
+}
+
+/**
+ * @brief Stops the prefetcher and closes (and so deletes) the spill file.
+ */
+RegionStore::~RegionStore() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) worker.join();
+    std::fclose(spill);
+}
+
+/**
+ * @brief Writes to the spill file. Callers hold ioMutex once the prefetcher runs.
+ * @param data The bytes to write.
+ * @param length How many bytes.
+ * @param offset Where to write them.
+ * @throws std::runtime_error If the write fails.
+ */
+void RegionStore::write(const void* data, size_t length, uint64_t offset) {
+    if (std::fseek(spill, static_cast<long>(offset), SEEK_SET) != 0 || std::fwrite(data, 1, length, spill) != length) {
+        throw std::runtime_error("Cannot write the region spill file");
+    }
+}
+
+/**
+ * @brief Spills a description as a 32-bit length and its bytes. Locations must arrive in id order,
+ *        which keeps each region's descriptions in one contiguous block.
+ * @param location The location id.
+ * @param text The description.
+ */
+void RegionStore::addDescription(size_t location, std::string_view text) {
+    Region& region = regions[regionOf(location)];
+    if (region.textLength == 0) region.textOffset = spillEnd;
+    uint32_t length = static_cast<uint32_t>(text.size());
+    write(&length, sizeof(length), spillEnd);
+    write(text.data(), text.size(), spillEnd + sizeof(length));
+    spillEnd += sizeof(length) + text.size();
+    region.textLength += sizeof(length) + text.size();
+}
+
+/**
+ * @brief Records an item placement while loading.
+ * @param location The location id.
+ * @param item The item id.
+ */
+void RegionStore::addItem(size_t location, size_t item) {
+    loadingItems.emplace_back(static_cast<uint32_t>(location), static_cast<uint32_t>(item));
+}
+
+/**
+ * @brief Spills the item placements as one sorted block per region and starts the prefetcher.
+ */
+void RegionStore::finish() {
+    std::stable_sort(loadingItems.begin(), loadingItems.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (auto first = loadingItems.begin(); first != loadingItems.end(); ) {
+        size_t region = regionOf(first->first);
+        auto last = std::find_if(first, loadingItems.end(), [&](const auto& p) { return regionOf(p.first) != region; });
+        size_t bytes = (last - first) * sizeof(*first);
+        regions[region].itemOffset = spillEnd;
+        regions[region].itemLength = bytes;
+        write(&*first, bytes, spillEnd);
+        spillEnd += bytes;
+        first = last;
+    }
+    std::vector<std::pair<uint32_t, uint32_t>>().swap(loadingItems);
+    std::fflush(spill);
+    worker = std::thread(&RegionStore::run, this);
+}
+
+size_t RegionStore::regionOf(size_t location) const { return location / regionSize; } ///< Returns the region a location belongs to.
+size_t RegionStore::budget() const { return maxResident; } ///< Returns how many regions may be resident.
+size_t RegionStore::residentCount() const { return recency.size(); } ///< Returns how many regions are resident.
+bool RegionStore::isResident(size_t region) const { return regions[region].resident; } ///< Returns whether a region is paged in.
+size_t RegionStore::coldest() const { return recency.back(); } ///< Returns the least recently used resident region.
+
+/**
+ * @brief Marks a resident region most recently used.
+ * @param region The region.
+ */
+void RegionStore::markUsed(size_t region) {
+    recency.splice(recency.begin(), recency, regions[region].used);
+}
+
+/**
+ * @brief Reads and decodes a region's blocks. Safe to call from the prefetcher.
+ * @param region The region.
+ * @return The decoded page.
+ * @throws std::runtime_error If the spill file cannot be read.
+ */
+RegionStore::Page RegionStore::read(size_t region) {
+    uint64_t textOffset, textLength, itemOffset, itemLength;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const Region& r = regions[region];
+        textOffset = r.textOffset, textLength = r.textLength, itemOffset = r.itemOffset, itemLength = r.itemLength;
+    }
+
+    std::string text(textLength, '\0');
+    Page page;
+    page.items.resize(itemLength / sizeof(page.items[0]));
+    {
+        std::lock_guard<std::mutex> io(ioMutex);
+        if (std::fseek(spill, static_cast<long>(textOffset), SEEK_SET) != 0 ||
+            std::fread(text.data(), 1, text.size(), spill) != text.size() ||
+            std::fseek(spill, static_cast<long>(itemOffset), SEEK_SET) != 0 ||
+            std::fread(page.items.data(), 1, itemLength, spill) != itemLength) {
+            throw std::runtime_error("Cannot read the region spill file");
+        }
+    }
+
+    page.text = std::make_unique<TextTable>();
+    page.descriptions.reserve(std::min(regionSize, locationCount - region * regionSize));
+    for (size_t at = 0; at + sizeof(uint32_t) <= text.size(); ) {
+        uint32_t length;
+        std::memcpy(&length, text.data() + at, sizeof(length));
+        at += sizeof(length);
+        page.descriptions.push_back(page.text->add(std::string_view(text).substr(at, length)));
+        at += length;
+    }
+    return page;
+}
+
+/**
+ * @brief Pages a region in, preferring a prefetched page and waiting out one being read.
+ * @param region The region, which must not be resident.
+ * @return The page; its text stays with the store until the region is released.
+ */
+RegionStore::Page RegionStore::take(size_t region) {
+    Page page;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        queue.erase(std::remove(queue.begin(), queue.end(), region), queue.end());
+        wake.wait(lock, [&] { return loading != region; });
+        auto it = ready.find(region);
+        if (it != ready.end()) {
+            page = std::move(it->second);
+            ready.erase(it);
+            readyOrder.erase(std::find(readyOrder.begin(), readyOrder.end(), region));
+        }
+    }
+    if (!page.text) page = read(region);
+
+    Region& r = regions[region];
+    r.resident = true;
+    r.text = std::move(page.text);
+    r.pagedItems = page.items;
+    recency.push_front(region);
+    r.used = recency.begin();
+    return page;
+}
+
+/**
+ * @brief Pages a region out. Changed items are appended as a new block; the old one is simply abandoned.
+ * @param region The resident region.
+ * @param items (location id, item id) for every item now in the region.
+ */
+void RegionStore::release(size_t region, std::vector<std::pair<uint32_t, uint32_t>> items) {
+    Region& r = regions[region];
+    recency.erase(r.used);
+    r.resident = false;
+    r.text.reset();
+
+    std::stable_sort(items.begin(), items.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    if (items != r.pagedItems) {
+        uint64_t offset;
+        {
+            std::lock_guard<std::mutex> io(ioMutex);
+            offset = spillEnd;
+            write(items.data(), items.size() * sizeof(items[0]), offset);
+            std::fflush(spill);
+            spillEnd += items.size() * sizeof(items[0]);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        r.itemOffset = offset;
+        r.itemLength = items.size() * sizeof(items[0]);
+    }
+    std::vector<std::pair<uint32_t, uint32_t>>().swap(r.pagedItems);
+}
+
+/**
+ * @brief Asks the worker to read a region ahead of need. Resident, queued and ready regions are skipped.
+ * @param region The region.
+ */
+void RegionStore::prefetch(size_t region) {
+    if (regions[region].resident) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (loading == region || ready.count(region) ||
+            std::find(queue.begin(), queue.end(), region) != queue.end()) return;
+        queue.push_back(region);
+    }
+    wake.notify_all();
+}
+
+/**
+ * @brief Reads queued regions until stopped. Ready pages are capped at the budget, dropping the oldest requests.
+ */
+void RegionStore::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || !queue.empty(); });
+        if (stopping) return;
+        loading = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        Page page;
+        try {
+            page = read(loading);
+        } catch (const std::exception&) {
+            // Leave it to take(), which reads again and reports the error on the game thread
+        }
+        lock.lock();
+        if (page.text) {
+            if (ready.size() >= maxResident) {
+                ready.erase(readyOrder.front());
+                readyOrder.pop_front();
+            }
+            ready.emplace(loading, std::move(page));
+            readyOrder.push_back(loading);
+        }
+        loading = World::npos;
+        wake.notify_all();
+    }
+}
+
+/**
+ * @brief Builds a world from world-file text.
+ * @param in The stream to read; it is read several times, so it must be seekable.
+ * @param residentRegions If nonzero, stream location contents through a RegionStore with this budget.
+ * @return The new world.
+ * @throws std::runtime_error Naming the offending line if the data is malformed.
+ */
+std::shared_ptr<World> World::parse(std::istream& in, size_t residentRegions) {
+    auto world = std::make_shared<World>();
+
+    // The file is read a line at a time, once per pass, so only one line is ever held
+    std::string text;
+    auto restart = [&] {
+        in.clear();
+        if (!in.seekg(0)) throw std::runtime_error("World data must be seekable");
+    };
+
+    // Size the tables up front: the arena never reclaims the buffers a growing vector leaves behind
+    // The first read also fingerprints the directives (FNV-1a), so comment edits don't change the version
+    size_t locationCount = 0;
+    uint32_t fingerprint = 2166136261u;
+    restart();
+    while (std::getline(in, text)) {
+        std::string_view line = trim(text);
+        if (line.empty() || line[0] == '#') continue;
+        if (line.substr(0, 9) == "location ") ++locationCount;
+        for (char c : line) fingerprint = (fingerprint ^ static_cast<uint8_t>(c)) * 16777619u;
+        fingerprint = (fingerprint ^ '\n') * 16777619u;
+    }
+    world->fingerprint = fingerprint;
+    world->locations.reserve(locationCount);
+    world->locationIndex.reserve(locationCount);
+    if (residentRegions > 0) world->regions = std::make_unique<RegionStore>(locationCount, residentRegions);
+
+    // Two passes: locations and NPCs first, so everything else can refer to them by name
+    for (int pass = 0; pass < 2; ++pass) {
+        restart();
+        for (size_t number = 1; std::getline(in, text); ++number) {
+            std::string_view line = trim(text);
+            if (line.empty() || line[0] == '#') continue;
+
+            size_t space = line.find(' ');
+            std::string_view directive = line.substr(0, space);
+            std::vector<std::string_view> fields = splitFields(space == std::string_view::npos ? "" : line.substr(space + 1));
+            auto fail = [&](const std::string& why) -> std::runtime_error {
+                return std::runtime_error("World line " + std::to_string(number) + ": " + why);
+            };
+            auto locationOf = [&](std::string_view name) {
+                size_t index = world->indexOf(name);
+                if (index == npos) throw fail("unknown location '" + std::string(name) + "'");
+                return index;
+            };
+            auto npcOf = [&](std::string_view name) {
+                size_t index = world->npcIndexOf(name);
+                if (index == npos) throw fail("unknown NPC '" + std::string(name) + "'");
+                return index;
+            };
+            auto expect = [&](size_t count) {
+                if (fields.size() != count) throw fail("'" + std::string(directive) + "' takes " + std::to_string(count) + " fields");
+            };
+
+            try {
+                if (pass == 0 && directive == "location") {
+                    expect(2);
+                    std::pmr::string key(fields[0], &world->pool);
+                    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+                    if (!world->locationIndex.emplace(std::move(key), world->locations.size()).second) {
+                        throw fail("duplicate location '" + std::string(fields[0]) + "'");
+                    }
+                    if (fields[1].empty()) throw fail("blank description for '" + std::string(fields[0]) + "'");
+                    size_t id = world->locations.size();
+                    if (world->regions) {
+                        world->locations.emplace_back(fields[0], Text());
+                        world->regions->addDescription(id, fields[1]);
+                    } else {
+                        world->locations.emplace_back(fields[0], world->text.add(fields[1]));
+                    }
+                    world->locations.back().setId(id);
+                    world->search.add(SearchIndex::Kind::Location, id, fields[0], fields[1]);
+                } else if (pass == 0 && directive == "npc") {
+                    expect(2);
+                    std::pmr::string key(fields[0], &world->pool);
+                    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+                    if (!world->npcIndex.emplace(std::move(key), world->npcs.size()).second) {
+                        throw fail("duplicate NPC '" + std::string(fields[0]) + "'");
+                    }
+                    world->npcs.emplace_back(fields[0], world->text.add(fields[1]), world->dialogue);
+                    world->npcs.back().setId(world->npcs.size() - 1);
+                    world->search.add(SearchIndex::Kind::NPC, world->npcs.size() - 1, fields[0], fields[1]);
+                } else if (pass == 1 && directive == "say") {
+                    expect(2);
+                    world->npcs[npcOf(fields[0])].addMessage(fields[1]);
+                } else if (pass == 1 && directive == "place") {
+                    expect(2);
+                    world->locations[locationOf(fields[1])].add_npc(npcOf(fields[0]));
+                } else if (pass == 1 && directive == "item") {
+                    expect(5);
+                    size_t location = locationOf(fields[0]);
+                    int calories = std::stoi(std::string(fields[3]));
+                    float weight = std::stof(std::string(fields[4]));
+
+                    // An item id stands for one item, so every line for a name must describe the same item
+                    size_t kind = world->itemIndexOf(fields[1]);
+                    if (kind == npos) {
+                        kind = world->internItem(Item(fields[1], world->text.add(fields[2]), calories, weight));
+                    } else {
+                        const Item& known = world->itemKinds[kind];
+                        if (known.getCalories() != calories || known.getWeightHundredths() != std::lround(weight * 100) ||
+                            known.getDescription().str() != fields[2]) {
+                            throw fail("item '" + std::string(fields[1]) + "' is already defined differently");
+                        }
+                    }
+                    if (world->regions) {
+                        world->regions->addItem(location, kind); // Streamed items are kept as ids until paged in
+                    } else {
+                        world->locations[location].add_item(world->itemKinds[kind]);
+                    }
+                    world->search.add(SearchIndex::Kind::Item, location, fields[1], fields[2]);
+                } else if (pass == 1 && directive == "exit") {
+                    expect(3);
+                    world->locations[locationOf(fields[0])].add_location(fields[1], &world->locations[locationOf(fields[2])]);
+                } else if (pass == 1 && directive == "crowd") {
+                    if (fields.size() != 4 && fields.size() != 5) throw fail("'crowd' takes <npc> | <count> | <location> | wander, or ... | seek | <target>");
+                    size_t archetype = npcOf(fields[0]);
+                    if (fields[1].empty() || !std::all_of(fields[1].begin(), fields[1].end(), ::isdigit)) {
+                        throw fail("crowd count must be a whole number");
+                    }
+                    size_t count = std::stoul(std::string(fields[1]));
+                    size_t start = locationOf(fields[2]);
+                    if (fields[3] == "wander" && fields.size() == 4) {
+                        world->crowd.add(archetype, count, start, Crowd::Rule::Wander);
+                    } else if (fields[3] == "seek" && fields.size() == 5) {
+                        world->crowd.add(archetype, count, start, Crowd::Rule::Seek, locationOf(fields[4]));
+                    } else {
+                        throw fail("crowd rule must be 'wander' or 'seek | <target>'");
+                    }
+                } else if (pass == 1 && directive == "avoid") {
+                    expect(1);
+                    world->crowd.avoid(locationOf(fields[0]));
+                } else if (pass == 1 && (directive == "at" || directive == "every")) {
+                    if (fields.size() < 2) throw fail("'" + std::string(directive) + "' needs a delay and an action");
+                    TimedEvent event{TimedEvent::Action::Say, 0, 0, 0, 0, {0, 0}, "", nullptr};
+                    if (fields[0].empty() || fields[0].size() > 9 || !std::all_of(fields[0].begin(), fields[0].end(), ::isdigit)) {
+                        throw fail("delay must be a whole number of seconds");
+                    }
+                    uint32_t seconds = static_cast<uint32_t>(std::stoul(std::string(fields[0])));
+                    event.period = directive == "every" ? std::max<uint32_t>(1, seconds) : 0;
+
+                    if (fields[1] == "say") {
+                        if (fields.size() != 4) throw fail("timed 'say' takes <npc> | <message>");
+                        if (event.period > 0) throw fail("'say' can only be timed with 'at'; a repeating line would pile up");
+                        event.action = TimedEvent::Action::Say;
+                        event.npc = npcOf(fields[2]);
+                        event.message = world->dialogue.add(fields[3]);
+                    } else if (fields[1] == "respawn") {
+                        if (fields.size() != 4) throw fail("timed 'respawn' takes <location> | <item>");
+                        event.action = TimedEvent::Action::Respawn;
+                        event.location = locationOf(fields[2]);
+                        const Item* item = nullptr;
+                        if (world->regions) {
+                            // Streamed locations hold no items yet, so any item already defined will do
+                            size_t kind = world->itemIndexOf(fields[3]);
+                            if (kind != npos) item = &world->itemKinds[kind];
+                        } else {
+                            const auto& items = world->locations[event.location].get_items();
+                            auto it = std::find_if(items.begin(), items.end(),
+                                [&](const Item& i) { return equalsIgnoreCase(i.getName(), fields[3]); });
+                            if (it != items.end()) item = &*it;
+                        }
+                        if (!item) throw fail("no item '" + std::string(fields[3]) + "' at that location to respawn");
+                        event.item = world->itemTemplates.size();
+                        world->itemTemplates.push_back(*item);
+                    } else if (fields[1] == "toggle") {
+                        if (fields.size() != 4) throw fail("timed 'toggle' takes <location> | <direction>");
+                        event.action = TimedEvent::Action::Toggle;
+                        event.location = locationOf(fields[2]);
+                        event.direction = std::string(fields[3]);
+                        if (world->locations[event.location].neighbors.count(std::pmr::string(fields[3])) == 0) {
+                            throw fail("no exit '" + event.direction + "' to toggle");
+                        }
+                    } else {
+                        throw fail("unknown timed action '" + std::string(fields[1]) + "'");
+                    }
+
+                    world->timers.schedule(seconds, static_cast<uint32_t>(world->events.size()));
+                    world->events.push_back(std::move(event));
+                } else if (directive != "location" && directive != "npc" && directive != "say" && directive != "place" &&
+                           directive != "item" && directive != "exit" && directive != "at" && directive != "every" &&
+                           directive != "crowd" && directive != "avoid") {
+                    throw fail("unknown directive '" + std::string(directive) + "'");
+                }
+            } catch (const std::runtime_error&) {
+                throw;
+            } catch (const std::exception& e) {
+                throw fail(e.what());
+            }
+        }
+    }
+
+    if (world->locations.empty()) {
+        throw std::runtime_error("World has no locations.");
+    }
+
+    world->search.finish();
+    if (world->regions) world->regions->finish();
+
+    if (world->crowd.size() > 0) {
+        world->crowd.settle(world->locations);
+        TimedEvent simulate{TimedEvent::Action::Simulate, crowdInterval, 0, 0, 0, {0, 0}, "", nullptr};
+        world->timers.schedule(crowdInterval, static_cast<uint32_t>(world->events.size()));
+        world->events.push_back(std::move(simulate));
+    }
+    return world;
+}
+
+/**
+ * @brief Builds a world from a world file.
+ * @param path The file to read.
+ * @param residentRegions If nonzero, stream location contents through a RegionStore with this budget.
+ * @return The new world.
+ * @throws std::runtime_error If the file cannot be read or is malformed.
+ */
+std::shared_ptr<World> World::load(const std::string& path, size_t residentRegions) {
+    std::ifstream file(path);
+    if (!file) throw std::runtime_error("Cannot open world file " + path);
+    return parse(file, residentRegions);
+}
+
+/**
+ * @brief Builds a world from a copy of a world file, then names the copy after the world's fingerprint.
+ *
+ * The copy is what gets parsed, so the kept version matches the world exactly even if the file changes again meanwhile.
+ * @param path The file to copy and read.
+ * @param residentRegions If nonzero, stream location contents through a RegionStore with this budget.
+ * @param directory Where versions are kept.
+ * @return The new world.
+ * @throws std::runtime_error If the file cannot be copied or read, or is malformed.
+ */
+std::shared_ptr<World> World::loadVersion(const std::string& path, size_t residentRegions, const std::string& directory) {
+    std::string copy = (std::filesystem::path(directory) / "world.loading").string();
+    std::filesystem::copy_file(path, copy, std::filesystem::copy_options::overwrite_existing);
+    std::shared_ptr<World> world = load(copy, residentRegions);
+    std::filesystem::rename(copy, versionPath(directory, world->fingerprint));
+    return world;
+}
+
+/**
+ * @brief Returns where loadVersion() keeps a world version.
+ * @param directory Where versions are kept.
+ * @param fingerprint The version's fingerprint.
+ * @return The path of the kept copy.
+ */
+std::string World::versionPath(const std::string& directory, uint32_t fingerprint) {
+    return (std::filesystem::path(directory) / ("world-" + std::to_string(fingerprint) + ".world")).string();
+}
+
+/**
+ * @brief Builds the festival shipped with the game.
+ * @return The new world.
+ */
+std::shared_ptr<World> World::builtIn() {
+    std::istringstream in(builtInWorld);
+    return parse(in);
+}
+
+/**
+ * @brief Advances the world clock, firing due timed events.
+ * @param seconds The seconds elapsed since the last call.
+ * @param notify Called with a location id and a line to show players there.
+ */
+void World::tick(uint64_t seconds, const std::function<void(size_t, std::string_view)>& notify) {
+    timers.advance(seconds, [&](uint32_t index) {
+        TimedEvent& event = events[index];
+        fire(event, notify);
+        if (event.period > 0) timers.schedule(event.period, index);
+    });
+}
+
+/**
+ * @brief Applies one timed event to the world.
+ * @param event The event to apply.
+ * @param notify Called with a location id and a line to show players there.
+ */
+void World::fire(TimedEvent& event, const std::function<void(size_t, std::string_view)>& notify) {
+    switch (event.action) {
+        case TimedEvent::Action::Say:
+            npcs[event.npc].addMessage(event.message);
+            break;
+        case TimedEvent::Action::Respawn: {
+            touch(event.location);
+            Location& location = locations[event.location];
+            const Item& item = itemTemplates[event.item];
+            const auto& items = location.get_items();
+            if (std::none_of(items.begin(), items.end(), [&](const Item& i) { return i.getName() == item.getName(); })) {
+                location.add_item(item);
+                notify(event.location, std::string(item.getName()) + " is back.");
+            }
+            break;
+        }
+        case TimedEvent::Action::Toggle: {
+            auto& neighbors = locations[event.location].neighbors;
+            std::pmr::string direction(event.direction, &pool);
+            auto open = neighbors.find(direction);
+            if (open != neighbors.end()) {
+                event.exitTarget = open->second;
+                neighbors.erase(open);
+                notify(event.location, "The way " + event.direction + " closes.");
+            } else if (event.exitTarget) {
+                neighbors.emplace(std::move(direction), event.exitTarget);
+                notify(event.location, "The way " + event.direction + " opens up again.");
+            }
+            crowd.markGraphDirty();
+            break;
+        }
+        case TimedEvent::Action::Simulate:
+            crowd.step(locations);
+            break;
+    }
+}
+
+size_t World::indexOf(std::string_view name) const { return lookup(locationIndex, name); } ///< Returns a location's index by case-insensitive name, or npos.
+size_t World::npcIndexOf(std::string_view name) const { return lookup(npcIndex, name); } ///< Returns an NPC's id by case-insensitive name, or npos.
+size_t World::itemIndexOf(std::string_view name) const { return lookup(itemIndex, name); } ///< Returns an item's id by case-insensitive name, or npos.
+
+/**
+ * @brief Returns an item's id by name, assigning the next id to names not seen before.
+ * @param item The item; the first of each name is kept in itemKinds.
+ * @return The item id.
+ */
+size_t World::internItem(const Item& item) {
+    std::pmr::string key(item.getName(), &pool);
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    auto [it, added] = itemIndex.emplace(std::move(key), itemIndex.size());
+    if (added) {
+        itemKinds.push_back(item);
+        itemKinds.back().setId(it->second);
+    }
+    return it->second;
+}
+
+/**
+ * @brief Pages in a location's region, evicting the least recently used regions over budget, and
+ *        prefetches the regions its exits lead into. Does nothing unless the world is streamed.
+ * @param location The location id.
+ */
+void World::touch(size_t location) {
+    if (!regions) return;
+    size_t region = regions->regionOf(location);
+    if (regions->isResident(region)) {
+        regions->markUsed(region);
+    } else {
+        RegionStore::Page page = regions->take(region);
+        size_t first = region * RegionStore::regionSize;
+        for (size_t i = 0; i < page.descriptions.size(); ++i) {
+            locations[first + i].setDescription(page.descriptions[i]);
+        }
+        for (const auto& [at, item] : page.items) {
+            locations[at].add_item(itemKinds[item]);
+        }
+        while (regions->residentCount() > regions->budget()) evict(regions->coldest());
+    }
+    for (const auto& exit : locations[location].neighbors) {
+        regions->prefetch(regions->regionOf(exit.second->getId()));
+    }
+}
+
+/**
+ * @brief Pages a region's contents out, handing its current items to the store for write-back.
+ * @param region The resident region.
+ */
+void World::evict(size_t region) {
+    std::vector<std::pair<uint32_t, uint32_t>> items;
+    size_t first = region * RegionStore::regionSize;
+    size_t last = std::min(first + RegionStore::regionSize, locations.size());
+    for (size_t id = first; id < last; ++id) {
+        for (const Item& item : locations[id].get_items()) {
+            items.emplace_back(static_cast<uint32_t>(id), static_cast<uint32_t>(item.getId()));
+        }
+        locations[id].clear_items();
+        locations[id].setDescription(Text());
+    }
+    regions->release(region, std::move(items));
+}
+
+/**
+ * @brief Starts watching a world file.
+ * @param path The world file.
+ * @param residentRegions The region budget rebuilt worlds stream with, or 0 to load them whole.
+ */
+WorldWatcher::WorldWatcher(const std::string& path, size_t residentRegions, const std::string& versions)
+    : path(path), residentRegions(residentRegions), versions(versions) {
+    thread = std::thread(&WorldWatcher::run, this);
+}
+
+/**
+ * @brief Stops the watcher thread.
+ */
+WorldWatcher::~WorldWatcher() {
+    stopping = true;
+    if (thread.joinable()) thread.join();
+}
+
+/**
+ * @brief Takes the most recently rebuilt world, or nullptr if none is waiting. Never blocks on a rebuild.
+ * @return The new world, or nullptr.
+ */
+std::shared_ptr<World> WorldWatcher::poll() {
+    if (!std::atomic_load(&pending)) return nullptr;
+    return std::atomic_exchange(&pending, std::shared_ptr<World>());
+}
+
+/**
+ * @brief Loads the file and publishes the result, keeping the old world on errors.
+ */
+void WorldWatcher::rebuild() {
+    try {
+        std::atomic_store(&pending, versions.empty() ? World::load(path, residentRegions)
+                                                     : World::loadVersion(path, residentRegions, versions));
+    } catch (const std::exception& e) {
+        std::cerr << "World reload failed, keeping the current world: " << e.what() << std::endl;
+    }
+}
+
+#ifdef __linux__
+
+/**
+ * @brief Waits for inotify events on the file's directory and rebuilds when the file is rewritten or replaced.
+ */
+void WorldWatcher::run() {
+    std::filesystem::path file(path);
+    std::string directory = file.has_parent_path() ? file.parent_path().string() : ".";
+    std::string name = file.filename().string();
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return;
+    // Watch the directory: editors often save by writing a new file and renaming it over the old one
+    if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        ::close(fd);
+        return;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while (!stopping) {
+        pollfd ready{fd, POLLIN, 0};
+        if (::poll(&ready, 1, 250) <= 0) continue;
+
+        bool changed = false;
+        ssize_t length;
+        while ((length = ::read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* at = buffer; at < buffer + length; ) {
+                auto* event = reinterpret_cast<inotify_event*>(at);
+                if (event->len > 0 && name == event->name) changed = true;
+                at += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (changed) rebuild();
+    }
+    ::close(fd);
+}
+
+#else
+
+/**
+ * @brief Polls the file's modification time and rebuilds when it changes.
+ */
+void WorldWatcher::run() {
+    std::error_code error;
+    auto lastWrite = std::filesystem::last_write_time(path, error);
+    while (!stopping) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        auto write = std::filesystem::last_write_time(path, error);
+        if (!error && write != lastWrite) {
+            lastWrite = write;
+            rebuild();
+        }
+    }
+}
+
+#endif
+
+/**
+ * @brief Builds an empty feed.
+ * @param slotCount How many slots the ring holds; rounded up to a power of two.
+ */
+SpectatorFeed::SpectatorFeed(size_t slotCount) {
+    size_t count = 1;
+    while (count < slotCount) count <<= 1;
+    slots = std::make_unique<Slot[]>(count);
+    mask = count - 1;
+}
+
+/**
+ * @brief Appends text to the feed, one slot per slotBytes of text, overwriting the oldest slots.
+ * @param text The text to publish.
+ */
+void SpectatorFeed::publish(std::string_view text) {
+    uint64_t message = published.load(std::memory_order_relaxed);
+    for (size_t offset = 0; offset < text.size(); offset += slotBytes, ++message) {
+        Slot& slot = slots[message & mask];
+        size_t length = std::min(slotBytes, text.size() - offset);
+
+        // Mark the slot as being written before touching its text, so readers can tell it was torn
+        slot.sequence.store(2 * message + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.length.store(length, std::memory_order_relaxed);
+        for (size_t word = 0; word * sizeof(uint64_t) < length; ++word) {
+            uint64_t bits = 0;
+            std::memcpy(&bits, text.data() + offset + word * sizeof(uint64_t), std::min(sizeof(uint64_t), length - word * sizeof(uint64_t)));
+            slot.words[word].store(bits, std::memory_order_relaxed);
+        }
+        slot.sequence.store(2 * message + 2, std::memory_order_release);
+    }
+    published.store(message, std::memory_order_release);
+}
+
+SpectatorFeed::Reader SpectatorFeed::subscribe() const { return Reader(*this, published.load(std::memory_order_acquire)); } ///< Returns a reader that starts with the next message published.
+
+/**
+ * @brief Appends every message published since the last read, skipping any that were overwritten first.
+ * @param into Receives the text.
+ * @return How many messages were lost.
+ */
+uint64_t SpectatorFeed::Reader::read(std::string& into) {
+    uint64_t end = feed->published.load(std::memory_order_acquire);
+    uint64_t capacity = feed->mask + 1;
+    uint64_t lost = 0;
+    if (end - next > capacity) {
+        lost = end - capacity - next;
+        next = end - capacity;
+    }
+
+    char text[slotBytes];
+    for (; next < end; ++next) {
+        const Slot& slot = feed->slots[next & feed->mask];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * next + 2) { // The producer has lapped us since we read published
+            ++lost;
+            continue;
+        }
+
+        size_t length = std::min<size_t>(slot.length.load(std::memory_order_relaxed), slotBytes);
+        for (size_t word = 0; word * sizeof(uint64_t) < length; ++word) {
+            uint64_t bits = slot.words[word].load(std::memory_order_relaxed);
+            std::memcpy(text + word * sizeof(uint64_t), &bits, std::min(sizeof(uint64_t), length - word * sizeof(uint64_t)));
+        }
+
+        // Only keep the copy if the slot wasn't rewritten while we read it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            ++lost;
+            continue;
+        }
+        into.append(text, length);
+    }
+    return lost;
+}
+
+/**
+ * @brief Moves back to the oldest message still in the ring.
+ */
+void SpectatorFeed::Reader::catchUp() {
+    uint64_t end = feed->published.load(std::memory_order_acquire);
+    next = end > feed->mask + 1 ? end - (feed->mask + 1) : 0;
+}
+
+void SpectatorFeed::Reader::skipToLatest() { next = feed->published.load(std::memory_order_acquire); } ///< Drops everything unread.
+
+/**
+ * @brief Starts following a feed.
+ * @param feed The feed; must outlive the spectator.
+ * @param path The file to write, created or truncated.
+ * @throws std::runtime_error If the file cannot be opened.
+ */
+Spectator::Spectator(const SpectatorFeed& feed, const std::string& path) : reader(feed.subscribe()) {
+    auto file = std::make_unique<std::ofstream>(path, std::ios::trunc);
+    if (!*file) {
+        throw std::runtime_error("Cannot open spectator output " + path + ".");
+    }
+    output = std::move(file);
+    thread = std::thread(&Spectator::run, this);
+}
+
+/**
+ * @brief Drains what is left and stops the thread.
+ */
+Spectator::~Spectator() {
+    stopping = true;
+    if (thread.joinable()) thread.join();
+}
+
+/**
+ * @brief Polls the feed and copies new text out. The producer never signals readers, so this sleeps when idle.
+ */
+void Spectator::run() {
+    std::string text;
+    for (bool last = false; !last; ) {
+        last = stopping.load();
+        text.clear();
+        if (uint64_t lost = reader.read(text)) {
+            *output << "\n[Spectator fell behind; " << lost << " messages skipped]\n";
+        }
+        if (!text.empty()) {
+            *output << text << std::flush;
+        } else if (!last) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+namespace {
+
+/**
+ * @struct RecordHeader
+ * @brief The fixed part of a journal record; the item name follows it, then padding to 4 bytes.
+ */
+struct RecordHeader {
+    uint8_t type;       ///< EventJournal::EventType; written last to commit the record.
+    uint8_t nameLength; ///< Bytes of item name following the header.
+    uint16_t reserved;  ///< Always zero.
+    uint32_t location;  ///< The location id.
+    uint32_t subject;   ///< The NPC id for Talk events.
+};
+
+constexpr char segmentMagic[8] = {'G', 'V', 'Z', 'J', 'R', 'N', 'L', '1'}; ///< First bytes of every segment file.
+
+/**
+ * @brief Returns the on-disk size of a record, including its name and padding.
+ * @param nameLength The length of the record's item name.
+ * @return The record size in bytes.
+ */
+size_t recordSize(size_t nameLength) {
+    return (sizeof(RecordHeader) + nameLength + 3) & ~size_t(3);
+}
+
+/**
+ * @brief Finds the end of the committed records in a segment.
+ * @param data The segment contents.
+ * @param size The segment size in bytes.
+ * @return The offset just past the last committed record.
+ */
+size_t committedEnd(const char* data, size_t size) {
+    size_t offset = sizeof(segmentMagic);
+    while (offset + sizeof(RecordHeader) <= size && data[offset] != 0) {
+        size_t next = offset + recordSize(static_cast<uint8_t>(data[offset + 1]));
+        if (next > size) break;
+        offset = next;
+    }
+    return offset;
+}
+
+} // namespace
+
+EventJournal::~EventJournal() { unmapSegment(); } ///< Unmaps the current segment.
+
+bool EventJournal::isOpen() const { return base != nullptr; } ///< Returns whether the journal is accepting appends.
+
+/**
+ * @brief Returns the file name of a segment.
+ * @param directory The journal directory.
+ * @param index The segment index.
+ * @return The segment's path.
+ */
+std::string EventJournal::segmentPath(const std::string& directory, int index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "segment-%06d.gvzj", index);
+    return (std::filesystem::path(directory) / name).string();
+}
+
+/**
+ * @brief Returns a printable name for an event type.
+ * @param type The event type.
+ * @return The name, e.g. "take".
+ */
+const char* EventJournal::typeName(EventType type) {
+    switch (type) {
+        case EventType::Start: return "start";
+        case EventType::Go: return "go";
+        case EventType::Teleport: return "teleport";
+        case EventType::Portal: return "portal";
+        case EventType::Take: return "take";
+        case EventType::Give: return "give";
+        case EventType::Talk: return "talk";
+        case EventType::Undo: return "undo";
+        case EventType::Tick: return "tick";
+        case EventType::Reload: return "reload";
+        default: return "none";
+    }
+}
+
+/**
+ * @brief Opens a journal directory for appending, creating it if needed.
+ * @param directory The directory holding the segment files.
+ * @throws std::runtime_error If the directory or a segment cannot be created or mapped.
+ */
+void EventJournal::open(const std::string& directory) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) throw std::runtime_error("Cannot create journal directory " + directory + ": " + error.message());
+    this->directory = directory;
+
+    int last = 0;
+    while (std::filesystem::exists(segmentPath(directory, last + 1), error)) ++last;
+    mapSegment(last);
+}
+
+/**
+ * @brief Appends one event by copying it into the mapped segment.
+ * @param type What happened.
+ * @param location The location id the event happened at, or moved to.
+ * @param subject The NPC id for Talk events.
+ * @param name The item name for Take and Give events (truncated to 255 bytes).
+ */
+void EventJournal::append(EventType type, size_t location, size_t subject, std::string_view name) {
+    if (!isOpen()) return;
+
+    size_t nameLength = std::min<size_t>(name.size(), 255);
+    size_t size = recordSize(nameLength);
+    if (tail + size > segmentSize) {
+        mapSegment(segment + 1);
+    }
+
+    RecordHeader header{0, static_cast<uint8_t>(nameLength), 0,
+                        static_cast<uint32_t>(location), static_cast<uint32_t>(subject)};
+    char* record = base + tail;
+    std::memcpy(record, &header, sizeof(header));
+    if (nameLength > 0) std::memcpy(record + sizeof(header), name.data(), nameLength);
+
+    // Publish the type byte only after the body, so a torn record reads as unwritten
+    std::atomic_thread_fence(std::memory_order_release);
+    record[0] = static_cast<char>(type);
+    tail += size;
+}
+
+/**
+ * @brief Reads every complete event from a journal directory without opening it for writing.
+ * @param directory The directory holding the segment files.
+ * @return The events in the order they were appended.
+ */
+std::vector<EventJournal::Event> EventJournal::read(const std::string& directory) {
+    std::vector<Event> events;
+    for (int index = 0; ; ++index) {
+        std::ifstream file(segmentPath(directory, index), std::ios::binary);
+        if (!file) break;
+
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() < sizeof(segmentMagic) || std::memcmp(data.data(), segmentMagic, sizeof(segmentMagic)) != 0) break;
+
+        size_t end = committedEnd(data.data(), data.size());
+        for (size_t offset = sizeof(segmentMagic); offset < end; ) {
+            RecordHeader header;
+            std::memcpy(&header, data.data() + offset, sizeof(header));
+            events.push_back(Event{static_cast<EventType>(header.type), header.location, header.subject,
+                                   std::string(data.data() + offset + sizeof(header), header.nameLength)});
+            offset += recordSize(header.nameLength);
+        }
+    }
+    return events;
+}
+
+#ifndef _WIN32
+
+/**
+ * @brief Creates (if needed) and maps a segment, positioning tail after its last record.
+ * @param index The segment index.
+ * @throws std::runtime_error If the segment cannot be created or mapped.
+ */
+void EventJournal::mapSegment(int index) {
+    unmapSegment();
+
+    std::string path = segmentPath(directory, index);
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot open journal segment " + path);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (static_cast<size_t>(info.st_size) < segmentSize && ftruncate(fd, segmentSize) != 0)) {
+        ::close(fd);
+        fd = -1;
+        throw std::runtime_error("Cannot size journal segment " + path);
+    }
+
+    void* mapped = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        ::close(fd);
+        fd = -1;
+        throw std::runtime_error("Cannot map journal segment " + path);
+    }
+
+    base = static_cast<char*>(mapped);
+    segment = index;
+    if (std::memcmp(base, segmentMagic, sizeof(segmentMagic)) != 0) {
+        std::memcpy(base, segmentMagic, sizeof(segmentMagic));
+    }
+    tail = committedEnd(base, segmentSize);
+}
+
+/**
+ * @brief Unmaps the current segment. The kernel writes the pages back; nothing is flushed on the command path.
+ */
+void EventJournal::unmapSegment() {
+    if (base) munmap(base, segmentSize);
+    if (fd >= 0) ::close(fd);
+    base = nullptr;
+    fd = -1;
+    segment = -1;
+}
+
+#else
+
+void EventJournal::mapSegment(int) { throw std::runtime_error("Event journaling needs mmap, which this platform build lacks."); }
+void EventJournal::unmapSegment() {}
+
+#endif
+
+/**
+ * @brief Constructs an empty inventory.
+ * @param resource The memory resource the inventory allocates from.
+ */
+Inventory::Inventory(std::pmr::memory_resource* resource) : held(resource), slots(resource) {}
+
+/**
+ * @brief Adds items, stacking them onto any held items with the same id.
+ * @param item The item; its id must be set.
+ * @param count How many to add.
+ */
+void Inventory::add(const Item& item, uint32_t count) {
+    size_t id = item.getId();
+    if (id >= slots.size()) slots.resize(id + 1, 0);
+
+    if (slots[id] == 0) {
+        held.emplace_back(item, 0);
+        slots[id] = static_cast<uint32_t>(held.size());
+    }
+    Stack& stack = held[slots[id] - 1];
+    stack.count += count;
+
+    // Totals use the stacked item, which is also what remove() subtracts
+    itemCount += count;
+    totalWeight += static_cast<int64_t>(stack.item.getWeightHundredths()) * count;
+    totalPoints += static_cast<int64_t>(stack.item.getCalories()) * count;
+}
+
+/**
+ * @brief Removes one item by id. An emptied stack is replaced by the last stack, so nothing shifts.
+ * @param itemId The item's id.
+ * @return A copy of the removed item, or nothing if none is held.
+ */
+std::optional<Item> Inventory::remove(size_t itemId) {
+    if (itemId >= slots.size() || slots[itemId] == 0) return std::nullopt;
+
+    size_t index = slots[itemId] - 1;
+    std::optional<Item> removed(held[index].item);
+    itemCount -= 1;
+    totalWeight -= removed->getWeightHundredths();
+    totalPoints -= removed->getCalories();
+
+    if (--held[index].count == 0) {
+        if (index + 1 != held.size()) {
+            held[index] = std::move(held.back());
+            slots[held[index].item.getId()] = static_cast<uint32_t>(index + 1);
+        }
+        held.pop_back();
+        slots[itemId] = 0;
+    }
+    return removed;
+}
+
+/**
+ * @brief Returns a held item by id.
+ * @param itemId The item's id.
+ * @return The item, or nullptr if none is held.
+ */
+const Item* Inventory::find(size_t itemId) const {
+    return itemId < slots.size() && slots[itemId] != 0 ? &held[slots[itemId] - 1].item : nullptr;
+}
+
+/**
+ * @brief Returns how many of an item are held.
+ * @param itemId The item's id.
+ * @return The count, or 0.
+ */
+uint32_t Inventory::count(size_t itemId) const {
+    return itemId < slots.size() && slots[itemId] != 0 ? held[slots[itemId] - 1].count : 0;
+}
+
+const std::pmr::vector<Inventory::Stack>& Inventory::stacks() const { return held; } ///< Returns the held stacks, in no particular order.
+bool Inventory::empty() const { return held.empty(); } ///< Returns whether nothing is held.
+size_t Inventory::size() const { return itemCount; } ///< Returns the number of items held, counting each in a stack.
+int64_t Inventory::weight() const { return totalWeight; } ///< Returns the total weight in hundredths of a pound.
+int64_t Inventory::points() const { return totalPoints; } ///< Returns the total awesome points held.
+
+/**
+ * @brief Drops every item and resets the totals.
+ */
+void Inventory::clear() {
+    held.clear();
+    slots.clear();
+    itemCount = 0;
+    totalWeight = 0;
+    totalPoints = 0;
+}
+
+/**
+ * @brief Returns the process-wide board, shared by every session.
+ * @return The board.
+ */
+Leaderboard& Leaderboard::global() {
+    static Leaderboard board;
+    return board;
+}
+
+/**
+ * @brief Orders entries: faster first, then fewer commands, then more points; the session id breaks ties.
+ * @param a An entry.
+ * @param b Another entry.
+ * @return Whether a ranks above b.
+ */
+bool Leaderboard::better(const Entry& a, const Entry& b) {
+    if (a.millis != b.millis) return a.millis < b.millis;
+    if (a.commands != b.commands) return a.commands < b.commands;
+    if (a.points != b.points) return a.points > b.points;
+    return a.session < b.session;
+}
+
+/**
+ * @brief Adds a finished session, locking only its shard. An earlier entry for the same session is replaced.
+ * @param entry The session's result.
+ */
+void Leaderboard::record(const Entry& entry) {
+    Shard& shard = shards[entry.session % shardCount];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto [it, added] = shard.bySession.emplace(entry.session, entry);
+    if (!added) {
+        auto old = std::lower_bound(shard.entries.begin(), shard.entries.end(), it->second, better);
+        shard.entries.erase(old);
+        it->second = entry;
+    }
+    shard.entries.insert(std::upper_bound(shard.entries.begin(), shard.entries.end(), entry, better), entry);
+}
+
+/**
+ * @brief Returns the best entries, taking at most count from each shard and merging them.
+ * @param count How many entries to return.
+ * @return Up to count entries, best first.
+ */
+std::vector<Leaderboard::Entry> Leaderboard::top(size_t count) const {
+    std::vector<Entry> best;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        best.insert(best.end(), shard.entries.begin(), shard.entries.begin() + std::min(count, shard.entries.size()));
+    }
+    size_t kept = std::min(count, best.size());
+    std::partial_sort(best.begin(), best.begin() + kept, best.end(), better);
+    best.resize(kept);
+    return best;
+}
+
+/**
+ * @brief Returns a session's rank by counting, shard by shard, the entries that beat it.
+ * @param session The session's id.
+ * @return The 1-based rank, or nothing if the session has not finished.
+ */
+std::optional<size_t> Leaderboard::rank(uint64_t session) const {
+    Entry entry{};
+    {
+        const Shard& shard = shards[session % shardCount];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.bySession.find(session);
+        if (it == shard.bySession.end()) return std::nullopt;
+        entry = it->second;
+    }
+
+    size_t ahead = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ahead += std::lower_bound(shard.entries.begin(), shard.entries.end(), entry, better) - shard.entries.begin();
+    }
+    return ahead + 1;
+}
+
+/**
+ * @brief Returns how many sessions have finished.
+ * @return The number of entries.
+ */
+size_t Leaderboard::size() const {
+    size_t total = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.entries.size();
+    }
+    return total;
+}
+
+namespace {
+
+/**
+ * @brief Packs 64 entries of a bitset into one word.
+ * @param bits The bitset.
+ * @param word Which group of 64 entries to pack.
+ * @return The packed entries, entry 0 in the lowest bit.
+ */
+uint64_t packBits(const std::vector<bool>& bits, size_t word) {
+    uint64_t packed = 0;
+    for (size_t i = 0; i < 64 && word * 64 + i < bits.size(); ++i) {
+        if (bits[word * 64 + i]) packed |= uint64_t(1) << i;
+    }
+    return packed;
+}
+
+} // namespace
+
+/**
+ * @brief Starts a new history whose only version is the current state.
+ */
+void Game::resetHistory() {
+    SessionState state{currentLocation->getId(), caloriesNeeded, pointsDelivered,
+        PersistentArray<uint64_t>((visited.size() + 63) / 64, 0, &sessionPool),
+        PersistentArray<uint32_t>(world->itemKinds.size(), 0, &sessionPool),
+        PersistentArray<ItemIds>(world->locations.size(), nullptr, &sessionPool)};
+
+    for (size_t word = 0; word < state.visited.size(); ++word) {
+        if (uint64_t packed = packBits(visited, word)) state.visited = state.visited.set(word, packed);
+    }
+    for (const auto& stack : inventory.stacks()) {
+        state.held = state.held.set(stack.item.getId(), stack.count);
+    }
+
+    history.assign(1, std::move(state));
+    originalItems.clear();
+    touchedItems.clear();
+    touchedLocations.clear();
+}
+
+/**
+ * @brief Returns the ids of the items in a location, paging the location in if the world is streamed.
+ * @param location The location id.
+ * @return The ids, sorted, allocated from the session pool.
+ */
+ItemIds Game::itemsAt(size_t location) {
+    world->touch(location);
+    auto ids = std::allocate_shared<std::pmr::vector<uint32_t>>(std::pmr::polymorphic_allocator<std::byte>(&sessionPool));
+    for (const Item& item : world->locations[location].get_items()) {
+        ids->push_back(static_cast<uint32_t>(item.getId()));
+    }
+    std::sort(ids->begin(), ids->end());
+    return ids;
+}
+
+/**
+ * @brief Records a location's items in the current version the first time a command might change them.
+ *
+ * Placement is recorded lazily so huge worlds don't pay for locations the player never touches;
+ * filling in the current version this way doesn't change the state it describes.
+ * @param location The location id.
+ */
+void Game::recordItems(size_t location) {
+    SessionState& head = history.back();
+    if (head.placement.get(location)) return;
+
+    ItemIds items = itemsAt(location);
+    originalItems.emplace(location, items);
+    head.placement = head.placement.set(location, std::move(items));
+}
+
+/**
+ * @brief Adds a version if the last command changed anything. Only what the command could have touched is compared.
+ * @param startLocation Where the player was when the command started.
+ * @param amend Whether to fold the changes into the current version instead.
+ */
+void Game::commitState(size_t startLocation, bool amend) {
+    SessionState next = history.back();
+    bool changed = false;
+
+    if (next.location != currentLocation->getId() || next.caloriesNeeded != caloriesNeeded ||
+        next.pointsDelivered != pointsDelivered) {
+        next.location = currentLocation->getId();
+        next.caloriesNeeded = caloriesNeeded;
+        next.pointsDelivered = pointsDelivered;
+        changed = true;
+    }
+
+    for (size_t location : {startLocation, next.location}) {
+        uint64_t packed = packBits(visited, location / 64);
+        if (next.visited.get(location / 64) != packed) {
+            next.visited = next.visited.set(location / 64, packed);
+            changed = true;
+        }
+    }
+
+    touchedLocations.push_back(startLocation);
+    for (size_t location : touchedLocations) {
+        if (const ItemIds& before = next.placement.get(location)) {
+            ItemIds after = itemsAt(location);
+            if (*after != *before) {
+                next.placement = next.placement.set(location, std::move(after));
+                changed = true;
+            }
+        }
+    }
+    touchedLocations.clear();
+
+    for (size_t item : touchedItems) {
+        if (item < next.held.size() && next.held.get(item) != inventory.count(item)) {
+            next.held = next.held.set(item, inventory.count(item));
+            changed = true;
+        }
+    }
+    touchedItems.clear();
+
+    if (amend) {
+        history.back() = std::move(next);
+    } else if (changed) {
+        history.push_back(std::move(next));
+    }
 }
 
-std::string Item::getName() const { return name; } ///< Returns the name of the item.
-std::string Item::getDescription() const { return description; } ///< Returns the description of the item.
-int Item::getCalories() const { return calories; } ///< Returns the number of calories the item provides.
-float Item::getWeight() const { return weight; } ///< Returns the weight of the item in pounds.
+size_t Game::version() const { return history.size() - 1; } ///< Returns the current session version.
 
 /**
- * @brief Overloads the << operator to print Item details.
- * @param os The output stream.
- * @param item The Item object to print.
- * @return The output stream.
+ * @brief Restores the session to an earlier version. Only the parts that differ between the two versions are visited.
+ * @param version A version no later than version(); later versions are discarded.
+ * @throws std::out_of_range If the version does not exist.
  */
-std::ostream& operator<<(std::ostream& os, const Item& item) {
-    os << item.name << " (" << item.calories << " awesome points)- " << item.weight << " lb- " << item.description;
-    return os;
+void Game::rewind(size_t version) {
+    if (version >= history.size()) {
+        throw std::out_of_range("No session version " + std::to_string(version) + ".");
+    }
+    const SessionState& from = history.back();
+    const SessionState& to = history[version];
+
+    to.visited.diff(from.visited, [&](size_t word) {
+        uint64_t packed = to.visited.get(word);
+        for (size_t i = 0; i < 64 && word * 64 + i < visited.size(); ++i) {
+            visited[word * 64 + i] = (packed >> i) & 1;
+        }
+    });
+
+    to.held.diff(from.held, [&](size_t item) {
+        uint32_t wanted = to.held.get(item);
+        while (inventory.count(item) > wanted) inventory.remove(item);
+        if (inventory.count(item) < wanted) inventory.add(world->itemKinds[item], wanted - inventory.count(item));
+    });
+
+    to.placement.diff(from.placement, [&](size_t location) {
+        ItemIds wanted = to.placement.get(location) ? to.placement.get(location) : originalItems.at(location);
+        ItemIds present = itemsAt(location);
+        Location& place = world->locations[location];
+
+        std::vector<uint32_t> extra, missing;
+        std::set_difference(present->begin(), present->end(), wanted->begin(), wanted->end(), std::back_inserter(extra));
+        std::set_difference(wanted->begin(), wanted->end(), present->begin(), present->end(), std::back_inserter(missing));
+        for (uint32_t item : extra) {
+            const auto& items = place.get_items();
+            auto it = std::find_if(items.begin(), items.end(), [&](const Item& i) { return i.getId() == item; });
+            if (it != items.end()) place.remove_item(Item(*it));
+        }
+        for (uint32_t item : missing) {
+            place.add_item(world->itemKinds[item]);
+        }
+    });
+
+    currentLocation = &world->locations[to.location];
+    world->touch(to.location);
+    isInPotty = currentLocation->getName() == "Porta-Potty";
+    caloriesNeeded = to.caloriesNeeded;
+    pointsDelivered = to.pointsDelivered;
+    history.resize(version + 1);
 }
 
 /**
- * @brief Constructs an NPC object.
- * @param name The name of the NPC.
- * @param description A description of the NPC.
- * @throws std::invalid_argument If the name or description is empty.
+ * @brief Takes back the last one or more state-changing commands.
+ * @param target How many commands to take back; one if empty.
  */
-NPC::NPC(const std::string& name, const std::string& description) {
-    if (name.empty() || description.empty()) {
-        throw std::invalid_argument("Name and description cannot be blank.");
+void Game::undo(Args target) {
+    size_t steps = 1;
+    if (!target.empty()) {
+        try {
+            steps = std::stoul(std::string(target[0]));
+        } catch (const std::exception&) {
+            out << "Usage: undo [number of moves]\n";
+            return;
+        }
     }
 
-    this->name = name;
-    this->description = description;
-    this->messageNumber = 0;
-}
-
-std::string NPC::getName() const { return name; } ///< Returns the name of the NPC.
-std::string NPC::getDescription() const { return description; } ///< Returns the description of the NPC.
+    if (steps == 0 || version() == 0) {
+        out << "There is nothing to undo.\n";
+        return;
+    }
+    steps = std::min(steps, version());
 
-void NPC::addMessage(const std::string& message) { messages.push_back(message); } ///< Adds a message to the NPC's list of messages.
+    rewind(version() - steps);
+    journal.append(EventJournal::EventType::Undo, currentLocation->getId(), static_cast<uint32_t>(version()));
+    out << "Time rewinds " << steps << (steps == 1 ? " move" : " moves") << ". You are back at "
+        << currentLocation->getName() << ".\n";
+}
 
 /**
- * @brief Returns the next message in the NPC's list.
- * @return The next message.
+ * @brief Constructs a Game object and initializes the game world.
  */
-std::string NPC::getMessage() {
-    if (messages.empty()) {
-        return ("This NPC has no messages.");
+Game::Game() {
+    static std::atomic<uint64_t> sessions{0};
+    sessionId = ++sessions;
+    commands = setup_commands();
+    createWorld();
+    visited.assign(world->locations.size(), false);
+    clock = std::chrono::steady_clock::now();
+    started = clock;
+    caloriesNeeded = 500;
+    inProgress = true;
+    currentLocation = randomLocation();
+
+    if (currentLocation) {
+        visited[currentLocation->getId()] = true;
+    } else {
+        throw std::runtime_error("Error: No valid starting location.");
     }
-    std::string message = messages[messageNumber];
-    messageNumber = (messageNumber + 1) % messages.size();
-    return message;
+    resetHistory();
 }
 
 /**
- * @brief Overloads the << operator to print the NPC's name.
- * @param os The output stream.
- * @param npc The NPC object to print.
- * @return The output stream.
+ * @brief Switches to a world file and reloads it in the background whenever it changes.
+ * @param path The world file.
+ * @param residentRegions If nonzero, stream the world with this many regions resident.
+ * @throws std::runtime_error If the file cannot be read or is malformed.
  */
-std::ostream& operator<<(std::ostream& os, const NPC& npc) {
-    os << npc.name;
-    return os;
+void Game::watchWorld(const std::string& path, size_t residentRegions) {
+    worldPath = path;
+    worldRegions = residentRegions;
+    // A journaled session keeps every version it plays in, so recovery can replay against the same ones
+    adoptWorld(journalDirectory.empty() ? World::load(path, residentRegions)
+                                        : World::loadVersion(path, residentRegions, journalDirectory));
+    watcher = std::make_unique<WorldWatcher>(path, residentRegions, journalDirectory);
 }
 
 /**
- * @brief Constructs a Location object.
- * @param name The name of the location.
- * @param description A description of the location.
- * @throws std::invalid_argument If the name or description is empty.
+ * @brief Moves the session into a new world version.
+ *
+ * The player's location and discovered locations carry over by name, and items already in the inventory are removed
+ * from the new world so they are not duplicated. The old world is freed here unless something else still holds it.
+ * @param next The new world.
+ * @param arrival Where to put the player, or World::npos for the location of the same name (a random one if it is gone).
  */
-Location::Location(const std::string& name, const std::string& description) {
-    if (name.empty() || description.empty()) throw std::invalid_argument("Name and description cannot be blank.");
-    this->name = name;
-    this->description = description;
-    this->visited = false;
-}
+void Game::adoptWorld(std::shared_ptr<World> next, size_t arrival) {
+    std::vector<bool> nextVisited(next->locations.size(), false);
+    for (size_t i = 0; i < visited.size(); ++i) {
+        if (!visited[i]) continue;
+        size_t index = next->indexOf(world->locations[i].getName());
+        if (index != World::npos) nextVisited[index] = true;
+    }
+
+    size_t here = arrival != World::npos ? arrival : currentLocation ? next->indexOf(currentLocation->getName()) : World::npos;
 
-std::string Location::getName() const { return name; } ///< Returns the name of the location.
+    // Items take the new world's copy, so their ids and descriptions belong to the new world
+    auto carry = [&](const Item& item) -> const Item& {
+        size_t id = next->itemIndexOf(item.getName());
+        if (id == World::npos) {
+            Item copy(item.getName(), next->text.add(item.getDescription().str()), item.getCalories(), item.getWeight());
+            id = next->internItem(copy);
+        }
+        return next->itemKinds[id];
+    };
+    auto lowercase = [](std::string_view name) {
+        std::string key(name);
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        return key;
+    };
+
+    // Add what the session changed in this world to what it changed in earlier versions; only touched locations can differ
+    for (const auto& [location, original] : originalItems) {
+        auto& changes = worldChanges[std::string(world->locations[location].getName())];
+        for (uint32_t item : *original) --changes[lowercase(world->itemKinds[item].getName())];
+        ItemIds current = itemsAt(location);
+        for (uint32_t item : *current) ++changes[lowercase(world->itemKinds[item].getName())];
+    }
+
+    // Replay those changes onto the fresh world, so taken, dropped and delivered items stay where the session left them
+    for (auto location = worldChanges.begin(); location != worldChanges.end(); ) {
+        auto& changes = location->second;
+        for (auto change = changes.begin(); change != changes.end(); ) {
+            change = change->second == 0 ? changes.erase(change) : std::next(change);
+        }
+        size_t id = next->indexOf(location->first);
+        if (changes.empty()) {
+            location = worldChanges.erase(location);
+            continue;
+        }
+        if (id != World::npos) {
+            next->touch(id);
+            Location& place = next->locations[id];
+            for (const auto& [name, count] : changes) {
+                for (int removed = 0; removed < -count; ++removed) {
+                    const auto& items = place.get_items();
+                    auto it = std::find_if(items.begin(), items.end(),
+                        [&](const Item& i) { return equalsIgnoreCase(i.getName(), name); });
+                    if (it == items.end()) break;
+                    place.remove_item(Item(*it));
+                }
+                size_t kind = world->itemIndexOf(name);
+                for (int added = 0; added < count && kind != World::npos; ++added) {
+                    place.add_item(carry(world->itemKinds[kind]));
+                }
+            }
+        }
+        ++location;
+    }
 
-std::map<std::string, Location*> Location::get_locations() const { return neighbors; } ///< Returns the map of neighboring locations.
+    Inventory carried(&inventoryPool);
+    for (const Inventory::Stack& stack : inventory.stacks()) {
+        carried.add(carry(stack.item), stack.count);
+    }
+    inventory = std::move(carried);
+
+    // NPCs pick up the conversation where they left off
+    for (const NPC& npc : world->npcs) {
+        size_t id = next->npcIndexOf(npc.getName());
+        if (id != World::npos) next->npcs[id].setMessageNumber(npc.getMessageNumber());
+    }
+
+    world = std::move(next);
+    clock = std::chrono::steady_clock::now(); // The new world's timers start counting now
+    visited = std::move(nextVisited);
+    currentLocation = here != World::npos ? &world->locations[here] : randomLocation();
+    world->touch(currentLocation->getId());
+    visited[currentLocation->getId()] = true;
+    isInPotty = currentLocation->getName() == "Porta-Potty";
+    resetHistory(); // Item ids and location ids belong to the old world
+    journal.append(EventJournal::EventType::Reload, currentLocation->getId(), world->fingerprint);
+}
 
 /**
- * @brief Adds a neighboring location.
- * @param direction The direction of the neighboring location.
- * @param location A pointer to the neighboring location.
- * @throws std::invalid_argument If the direction is empty or already mapped.
+ * @brief Fires the world's timed events that came due since the last batch, journaling the tick so replay fires them at the same point.
  */
-void Location::add_location(const std::string& direction, Location* location) {
-    if (direction.empty()) {
-        throw std::invalid_argument("Direction cannot be empty.");
-    }
-    if (neighbors.count(direction) > 0) {
-        throw std::invalid_argument("That direction is already mapped for this location.");
+void Game::advanceClock() {
+    auto now = std::chrono::steady_clock::now();
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(now - clock);
+    if (seconds.count() <= 0) return;
+    clock += seconds; // Keep the sub-second remainder for next time
+
+    world->tick(seconds.count(), [&](size_t location, std::string_view line) {
+        if (currentLocation && currentLocation->getId() == location) out << line << "\n";
+        touchedLocations.push_back(location);
+    });
+    if (currentLocation) {
+        world->touch(currentLocation->getId()); // Respawns may have paged it out
+        journal.append(EventJournal::EventType::Tick, currentLocation->getId(), static_cast<uint32_t>(seconds.count()));
     }
-    neighbors[direction] = location;
 }
 
-void Location::add_npc(NPC& npc) { npcs.push_back(npc); } ///< Adds an NPC to the location.
-std::vector<NPC>& Location::get_npcs() { return npcs; } ///< Returns the list of NPCs in the location.
-void Location::add_item(const Item& item) { items.push_back(item); } ///< Adds an item to the location.
+/**
+ * @brief Records the win on the process-wide leaderboard and shows where it placed. Recovered sessions
+ *        are not ranked, since only the time and commands since the restart are known.
+ */
+void Game::finish() {
+    out << "\n";
+    if (recovered) {
+        out << "This session was recovered from a journal, so it is not ranked.\n";
+    } else {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        Leaderboard::global().record({sessionId, static_cast<uint64_t>(elapsed.count()), commandCount, pointsDelivered});
+    }
+    printScores(5);
+}
 
 /**
- * @brief Removes an item from the location.
- * @param item The item to remove.
+ * @brief Prints the best finishes and, if the player has finished, their rank.
+ * @param count How many finishes to list.
  */
-void Location::remove_item(const Item& item) {
-    auto it = std::find_if(items.begin(), items.end(),
-        [&item](const Item& i) { return i.getName() == item.getName(); });
-    if (it != items.end()) {
-        items.erase(it);
+void Game::printScores(size_t count) {
+    const Leaderboard& board = Leaderboard::global();
+    std::vector<Leaderboard::Entry> best = board.top(count);
+    if (best.empty()) {
+        out << "Nobody has saved Metalapokolips yet.\n";
+        return;
+    }
+
+    out << "FASTEST SAVIOURS:\n";
+    for (size_t i = 0; i < best.size(); ++i) {
+        const Leaderboard::Entry& entry = best[i];
+        out << i + 1 << ". Session " << entry.session << (entry.session == sessionId ? " (you)" : "") << " - "
+            << entry.millis / 60000 << "m " << entry.millis / 1000 % 60 << "." << entry.millis / 100 % 10 << "s, "
+            << entry.commands << " commands, " << entry.points << " awesome points\n";
+    }
+    if (std::optional<size_t> rank = board.rank(sessionId)) {
+        out << "You are ranked " << *rank << " of " << board.size() << ".\n";
     }
 }
 
-std::vector<Item> Location::get_items() const { return items; } ///< Returns the list of items in the location.
-void Location::set_visited() { visited = true; } ///< Marks the location as visited.
-bool Location::get_visited() const { return visited; } ///< Returns whether the location has been visited.
+/**
+ * @brief Mirrors everything the session prints to a file, from a spectator thread of its own.
+ * @param path The file to write.
+ * @throws std::runtime_error If the file cannot be opened.
+ */
+void Game::addSpectator(const std::string& path) {
+    spectators.push_back(std::make_unique<Spectator>(feed(), path));
+}
 
 /**
- * @brief Overloads the << operator to print Location details.
- * @param os The output stream.
- * @param location The Location object to print.
- * @return The output stream.
+ * @brief Returns the session's output feed, creating it on first use.
+ * @return The feed.
  */
-std::ostream& operator<<(std::ostream& os, const Location& location) {
-    // Location name and description
-    os << location.name << "- " << location.description << "\n\n";
+SpectatorFeed& Game::feed() {
+    if (!spectatorFeed) spectatorFeed = std::make_unique<SpectatorFeed>();
+    return *spectatorFeed;
+}
 
-    // List NPCs
-    os << "You see the following NPCs:\n";
-    if (location.npcs.empty()) {
-        os << "- None\n";
-    } else {
-        for (const NPC& npc : location.npcs) {
-            os << "- " << npc.getName() << ":" << npc.getDescription() << "\n";
-        }
+/**
+ * @brief Recovers the session from a journal directory, then journals new events to it.
+ *
+ * Call it before watchWorld(), so the world file's versions are kept in the directory and its loads are journaled.
+ * @param directory The journal directory; a new one starts a fresh journal at the current spawn point.
+ * @param residentRegions The region budget the journal's world versions are streamed with, or 0 to load them whole.
+ * @throws std::runtime_error If the journal cannot be opened or does not match this world.
+ */
+void Game::openJournal(const std::string& directory, size_t residentRegions) {
+    journalDirectory = directory;
+    worldRegions = residentRegions;
+    std::vector<EventJournal::Event> events = EventJournal::read(directory);
+    if (!events.empty()) {
+        replay(events);
+        recovered = true; // Commands and time before the restart were never journaled
+        std::cout << "Recovered session from " << events.size() << " journaled events." << std::endl;
     }
 
-    // List items
-    os << "\nYou see the following Items:\n";
-    if (location.items.empty()) {
-        os << "- None\n";
-    } else {
-        for (const Item& item : location.items) {
-            os << "- " << item.getName() << " (" << item.getCalories() << " awesome points) - "
-               << item.getWeight() << " lb- " << item.getDescription() << "\n";
-        }
+    journal.open(directory);
+    if (events.empty()) {
+        journal.append(EventJournal::EventType::Start, currentLocation->getId(), world->fingerprint);
     }
+}
 
-    // List directions
-    os << "\nYou can go in the following Directions:\n";
-    if (location.neighbors.empty()) {
-        os << "- None\n";
-    } else {
-        for (const auto& neighbor : location.neighbors) {
-            os << "- " << neighbor.first << "- "
-               << (neighbor.second->get_visited() ? neighbor.second->name : "Unknown")
-               << (neighbor.second->get_visited() ? " (Visited)" : "") << "\n";
+/**
+ * @brief Re-applies journaled events to rebuild session state. Prints nothing.
+ * @param events The events, in journal order.
+ * @throws std::runtime_error If an event refers to a location that does not exist or a world version that was not kept.
+ */
+void Game::replay(const std::vector<EventJournal::Event>& events) {
+    using EventType = EventJournal::EventType;
+
+    for (const auto& event : events) {
+        // Location ids only mean something in the world version they were journaled against
+        if (event.type == EventType::Reload || (event.type == EventType::Start && event.subject != world->fingerprint)) {
+            std::shared_ptr<World> next = journaledWorld(event.subject);
+            if (event.location >= next->locations.size()) throw std::runtime_error("The journal does not match this world.");
+            // Arrive where the live session did, even if adoptWorld() would have picked a random spawn
+            adoptWorld(std::move(next), event.type == EventType::Reload ? event.location : World::npos);
+        }
+        if (event.location >= world->locations.size()) {
+            throw std::runtime_error("The journal does not match this world.");
+        }
+        Location* location = &world->locations[event.location];
+        world->touch(event.location);
+        size_t startLocation = currentLocation->getId();
+        if (event.type == EventType::Take || event.type == EventType::Give) recordItems(event.location);
+
+        switch (event.type) {
+            case EventType::Start:
+                visited.assign(world->locations.size(), false);
+                visited[location->getId()] = true;
+                currentLocation = location;
+                resetHistory();
+                continue;
+            case EventType::Go:
+            case EventType::Teleport:
+            case EventType::Portal:
+                visited[location->getId()] = true;
+                currentLocation = location;
+                isInPotty = currentLocation->getName() == "Porta-Potty";
+                break;
+            case EventType::Take: {
+                const auto& items = location->get_items();
+                auto it = std::find_if(items.begin(), items.end(),
+                    [&](const Item& i) { return i.getName() == event.name; });
+                if (it != items.end()) {
+                    inventory.add(*it);
+                    touchedItems.push_back(it->getId());
+                    location->remove_item(*it);
+                }
+                break;
+            }
+            case EventType::Give: {
+                std::optional<Item> item = inventory.remove(world->itemIndexOf(event.name));
+                if (!item) break;
+                touchedItems.push_back(item->getId());
+                if (location->getName() == "VIP Lounge") {
+                    caloriesNeeded = std::max(0, caloriesNeeded - item->getCalories());
+                    pointsDelivered += item->getCalories();
+                } else {
+                    location->add_item(*item);
+                }
+                break;
+            }
+            case EventType::Talk:
+                if (event.subject < world->npcs.size()) world->npcs[event.subject].getMessage();
+                continue;
+            case EventType::Undo:
+                if (event.subject <= version()) rewind(event.subject);
+                continue;
+            case EventType::Tick:
+                world->tick(event.subject, [&](size_t changed, std::string_view) { touchedLocations.push_back(changed); });
+                world->touch(currentLocation->getId());
+                break;
+            default:
+                continue;
         }
+
+        // A portal finishes the give that opened it, which was one command and so one version; timers join the current one
+        commitState(startLocation, event.type == EventType::Portal || event.type == EventType::Tick);
     }
 
-    return os;
+    if (caloriesNeeded <= 0) inProgress = false;
 }
 
 /**
- * @brief Constructs a Game object and initializes the game world.
+ * @brief Loads a world version kept in the journal directory.
+ * @param fingerprint The version's fingerprint, as journaled.
+ * @return The world.
+ * @throws std::runtime_error If the version was not kept or cannot be loaded.
  */
-Game::Game() {
-    commands = setup_commands();
-    createWorld();
-    currentWeight = 0;
-    caloriesNeeded = 500;
-    inProgress = true;
-    currentLocation = randomLocation();
-
-    if (currentLocation) {
-        currentLocation->set_visited();
-    } else {
-        throw std::runtime_error("Error: No valid starting location.");
+std::shared_ptr<World> Game::journaledWorld(uint32_t fingerprint) {
+    std::string path = World::versionPath(journalDirectory, fingerprint);
+    if (!std::filesystem::exists(path)) {
+        throw std::runtime_error("The journal was recorded against a world version that is missing from " + journalDirectory + ".");
     }
+    return World::load(path, worldRegions);
 }
 
 /**
  * @brief Converts a string to lowercase.
  * @param str The string to convert.
- * @return The lowercase version of the string.
+ * @return The lowercase version of the string, allocated from the command pool.
  */
-std::string Game::toLowercase(const std::string& str) { //This function is ai generated
-    std::string lowerStr = str;
+std::pmr::string Game::toLowercase(std::string_view str) { //This function is ai generated
+    std::pmr::string lowerStr(str, &commandPool);
     std::transform(lowerStr.begin(), lowerStr.end(), lowerStr.begin(), ::tolower);
     return lowerStr;
 }
 
+/**
+ * @brief Finds an NPC the player can interact with here: a placed NPC first, then a crowd archetype with members here.
+ * @param name The NPC's name, in any case.
+ * @return The NPC id, or World::npos.
+ */
+size_t Game::findNpcHere(std::string_view name) {
+    for (size_t npcId : currentLocation->get_npcs()) {
+        if (equalsIgnoreCase(world->npcs[npcId].getName(), name)) return npcId;
+    }
+
+    size_t archetype = world->npcIndexOf(name);
+    if (archetype != World::npos && world->crowd.countAt(currentLocation->getId(), archetype) > 0) {
+        return archetype;
+    }
+    return World::npos;
+}
+
+/**
+ * @brief Joins arguments with single spaces.
+ * @param args The arguments to join.
+ * @return The joined string, allocated from the command pool.
+ */
+std::pmr::string Game::joinArgs(const Args& args) {
+    std::pmr::string joined(&commandPool);
+    for (const auto& arg : args) {
+        if (!joined.empty()) joined += " ";
+        joined += arg;
+    }
+    return joined;
+}
+
 /**
  * @brief Sets up the available commands.
  * @return A map of command names to their corresponding functions.
  */
-std::map<std::string, std::function<void(Game*, std::vector<std::string>)>> Game::setup_commands() {
-    std::map<std::string, std::function<void(Game*, std::vector<std::string>)>> commands;
+std::map<std::string, std::function<void(Game*, Args)>, std::less<>> Game::setup_commands() {
+    std::map<std::string, std::function<void(Game*, Args)>, std::less<>> commands;
     commands.insert(std::make_pair("help", &Game::showHelp));
     commands.insert(std::make_pair("talk", &Game::talk));
     commands.insert(std::make_pair("take", &Game::take));
@@ -241,6 +2932,11 @@ std::map<std::string, std::function<void(Game*, std::vector<std::string>)>> Game
     commands.insert(std::make_pair("i", &Game::showInventory));
     commands.insert(std::make_pair("hug", &Game::hug));
     commands.insert(std::make_pair("teleport", &Game::teleport));
+    commands.insert(std::make_pair("search", &Game::search));
+    commands.insert(std::make_pair("undo", &Game::undo));
+    commands.insert(std::make_pair("scores", &Game::scores));
+    commands.insert(std::make_pair("leaderboard", &Game::scores));
+    commands.insert(std::make_pair("memstats", &Game::memstats));
 
     return commands;
 }
@@ -276,168 +2972,16 @@ COMMANDS:
 - GIVE [item]    (contribute to the ultimate axe)
 - INVENTORY      (check your loot)
 - TELEPORT [location]    (teleports you to the location if you have visited it)
+- SEARCH [words] (find what mentions them)
+- UNDO [n]       (take back your last n moves)
+- SCORES         (the fastest saviours of the festival)
 - HELP           (show commands)
 - QUIT           (abandon the pit)
 
 The crowd is getting restless... Go melt some faces!
 )" << std::endl;
 
-
-
-// Create locations and add them to the vector
-locations.push_back(Location("Main Stage", "The heart of the festival, a colossal stage towering over the crowd. Flames erupt from the stage as the band rips into a brutal breakdown."));
-locations.push_back(Location("Second Stage", "A slightly smaller stage, but still packed with energy. The air smells like sweat, beer, and distortion pedals cranked to 11."));
-locations.push_back(Location("Third Stage", "A more underground stage, featuring extreme metal bands. The pit here is absolute chaos."));
-locations.push_back(Location("VIP Lounge", "An exclusive area behind the main stage. You hear whispers of legendary rockstars hanging out here."));
-locations.push_back(Location("Porta-Potty Row", "A long line of overused porta-potties. The air is thick with regret."));
-locations.push_back(Location("Porta-Potty", "Ew it stinks, and a carving on the wall says: *try down* weird."));
-locations.push_back(Location("Founders Beer Tent", "A massive beer tent, offering legendary brews. It’s crowded, but the drinks are worth it."));
-locations.push_back(Location("Three Floyds Beer Tent", "Another beer tent, home to Zombie Dust and more. You overhear someone say, 'Best beer at the fest!'"));
-locations.push_back(Location("Merch Booths", "A row of tents selling band shirts, records, and obscure patches. You spot a rare vinyl you’ve been hunting for years."));
-locations.push_back(Location("Food Court", "A collection of food trucks selling everything from greasy festival burgers to vegan burritos."));
-locations.push_back(Location("Medical Tent", "A small white tent with a red cross. Someone inside is getting their wounds patched up from a wild mosh pit."));
-locations.push_back(Location("Camping Grounds", "A sea of tents and campfires, where festival-goers rest between sets. Smells like beer, weed, and cheap ramen."));
-locations.push_back(Location("Parking Lot", "A large open area filled with cars. It’s noisy and smells like gasoline. Why did you come here?"));
-locations.push_back(Location("Hell", "You’ve somehow found yourself in Hell. But wait, is that Dimebag Darrell shredding in the distance?")); // Secret cheat code location
-
-    // Add NPCs to locations
-
-// 0: MS, 1: 2S, 2: 3S, 3: VIP, 4: PortaRow, 5: Potty, 6: Founders, 7: 3Floyds, 8: Merch
-// 9: FC, 10: Meds, 11: Camp, 12: Parking Lot, 13: hell
-
-NPC luthier("Dean", "Dean Zelinsky, a legendary luthier some even say he has powers.");
-luthier.addMessage("I need quality parts to build the ultimate axe!");
-luthier.addMessage("That's the stuff! Keep 'em coming!");
-luthier.addMessage("One more piece and this baby will scream!");
-locations[3].add_npc(luthier); // Add to VIP Lounge
-
-NPC soundEngineer("Sound Engineer", "A stressed-looking guy adjusting the mix.");
-soundEngineer.addMessage("If you mess with my soundboard, I swear to Dio…");
-soundEngineer.addMessage("This mix is the difference between a killer set and total disaster.");
-locations[0].add_npc(soundEngineer);
-
-NPC securityGuard("Security Guard", "A no-nonsense security guard scanning the crowd.");
-securityGuard.addMessage("Keep it safe, but go hard.");
-securityGuard.addMessage("No crowd surfing past the barricade!");
-locations[6].add_npc(securityGuard);
-
-NPC roadie("Roadie", "A rugged roadie moving amps.");
-roadie.addMessage("You think this job is easy? Load in at 6 AM, load out at 2 AM.");
-roadie.addMessage("We run this festival, not the bands.");
-locations[1].add_npc(roadie);
-
-NPC beerVendor("Beer Vendor", "A cheerful vendor pouring pints.");
-beerVendor.addMessage("One sip of this, and you'll be ready for the next set!");
-beerVendor.addMessage("We ran out of IPA? Damn, that was fast.");
-beerVendor.addMessage("*mumbling* I love my job.");
-locations[6].add_npc(beerVendor);
-locations[7].add_npc(beerVendor);
-
-// Metal legends in the VIP Lounge
-NPC ozzy("Ozzy Osbourne", "The Prince of Darkness himself, sipping a drink in the VIP Lounge.");
-ozzy.addMessage("Sharon! Where’s my bloody bat?!");
-ozzy.addMessage("Metal ain't dead, mate. Just evolving.");
-locations[3].add_npc(ozzy);
-
-NPC lemmy("Lemmy Kilmister", "The legendary Motörhead frontman, playing a slot machine in the corner.");
-lemmy.addMessage("If you think you’re too old for rock and roll, then you are.");
-lemmy.addMessage("Ace of Spades, mate! That’s the only song you need.");
-locations[3].add_npc(lemmy);
-
-NPC dimebag("Dimebag Darrell", "A ghostly presence, now a true Cowboy of Hell.");
-dimebag.addMessage("Dude, you made it to Hell? That’s METAL!");
-dimebag.addMessage("I got riffs that’d melt your face off. Want a lesson?");
-locations[13].add_npc(dimebag);
-
-NPC evh("Eddie Van Halen", "A ghostly presence, shredding in the fires of Hell.");
-dimebag.addMessage("What's up dude.");
-dimebag.addMessage("Wanna come try my rig?");
-locations[13].add_npc(evh);
-
-NPC ronnie("Ronnie James Dio", "The master of metal, throwing up the horns.");
-ronnie.addMessage("We are the last in line! Don’t forget that.");
-ronnie.addMessage("Man, Heaven and Hell still holds up!");
-locations[13].add_npc(ronnie);
-
-// 0: MS, 1: 2S, 2: 3S, 3: VIP, 4: PortaRow, 5: Potty, 6: Founders, 7: 3Floyds, 8: Merch
-// 9: FC, 10: Meds, 11: Camp, 12: Parking Lot, 13: hell
-
-locations[8].add_item(Item("Neck", "Maple guitar neck with rosewood fretboard", 50, 4.2));
-locations[1].add_item(Item("Body", "Solid mahogany body with flame top", 60, 8.5));
-locations[0].add_item(Item("Pickups", "High-output humbuckers with coil tapping", 45, 1.8));
-locations[3].add_item(Item("Tuners", "Locking machine heads for perfect tuning", 50, 0.9));
-locations[7].add_item(Item("Strings", "Heavy gauge nickel-wound strings", 45, 0.3));
-locations[11].add_item(Item("Floyd Rose", "Professional tremolo system", 65, 2.1));
-locations[2].add_item(Item("Bridge", "Fixed bridge for enhanced sustain", 55, 2.0));
-locations[13].add_item(Item("Pickguard", "Classic black pickguard", 40, 0.5));
-locations[0].add_item(Item("Nut", "Lol, Bone nut for better tone and sustain", 30, 0.1));
-locations[1].add_item(Item("Truss Rod", "Adjustable truss rod for neck stability", 35, 0.3));
-locations[2].add_item(Item("Volume Knob", "Gold-plated volume knob, a little dusty", 35, 0.2));
-locations[3].add_item(Item("Tone Knob", "Gold-plated tone knob actually kinda cool", 40, 0.2));
-locations[7].add_item(Item("Output Jack", "High-quality 1/4-inch output jack", 30, 0.1));
-locations[8].add_item(Item("Strap Buttons", "Secure locking strap buttons", 25, 0.2));
-locations[11].add_item(Item("Capacitor", "Orange drop capacitor for tone control", 30, 0.05));
-locations[13].add_item(Item("Dime's Floyd", "The Floyd Rose used by the goat himself", 120, 0.15));
-locations[13].add_item(Item("Hell Pickup", "Hand wound by EVH himself, this thing roars", 150, 0.15));
-
-// beers
-locations[7].add_item(Item("Gumballhead", "Delicious Pale Ale, cost you $18, but frankly, who's surprised", 0, 0.15));
-locations[7].add_item(Item("Zombie Dust", "Hellishly Hoppy IPA, cost you $93, awesome!", 0, 0.15));
-locations[6].add_item(Item("Mortal Bloom", "Quencing IPA, cost you $400, tastes floral and citrusy", 0, 0.15));
-locations[6].add_item(Item("All Day IPA", "Drinkable and Crisp, cost you $3.47, totally crushable", 0, 0.15));
-
-// Main Stage
-locations[0].add_location("north", &locations[3]);   // VIP Lounge
-locations[0].add_location("south", &locations[9]);   // Food Court
-locations[0].add_location("east", &locations[1]);    // Second Stage
-locations[0].add_location("west", &locations[2]);    // Third Stage
-
-// Second Stage
-locations[1].add_location("west", &locations[0]);    // Back to Main Stage
-locations[1].add_location("east", &locations[6]);    // Founders Beer Tent
-
-// Third Stage
-locations[2].add_location("east", &locations[0]);    // Back to Main Stage
-locations[2].add_location("west", &locations[7]);    // Three Floyds Beer Tent
-
-// VIP Lounge
-locations[3].add_location("south", &locations[0]);   // Back to Main Stage
-
-// Food Court (9)
-locations[9].add_location("north", &locations[0]);   // Main Stage
-locations[9].add_location("south", &locations[10]);  // Medical Tent
-locations[9].add_location("east", &locations[6]);    // Founders Beer Tent
-locations[9].add_location("west", &locations[7]);    // Three Floyds Beer Tent
-locations[9].add_location("northeast", &locations[8]);// Merch Booths
-locations[9].add_location("northwest", &locations[4]);// Porta-Potty Row
-
-// Porta-Potty Row (4)
-locations[4].add_location("southeast", &locations[9]);// Back to Food Court
-locations[4].add_location("enter", &locations[5]);    // Into Porta-Potty
-
-// Porta-Potty
-locations[5].add_location("down", &locations[13]);   // Secret path to Hell
-
-// Medical Tent (10)
-locations[10].add_location("north", &locations[9]);  // Back to Food Court
-locations[10].add_location("south", &locations[11]); // Camping Grounds
-
-// Camping Grounds (11)
-locations[11].add_location("north", &locations[10]); // Back to Medical
-locations[11].add_location("east", &locations[12]);  // Parking Lot
-
-// Parking Lot (12)
-locations[12].add_location("west", &locations[11]);  // Back to Camping
-
-// Beer Tent Connections (6/7)
-locations[6].add_location("west", &locations[9]);    // Founders -> Food Court
-locations[7].add_location("east", &locations[9]);    // Three Floyds -> Food Court
-
-// Merch Booths (8)
-locations[8].add_location("southwest", &locations[9]);// Back to Food Court
-
-// portal out of hell into vip lounge
-locations[13].add_location("north", &locations[3]);
+    world = World::builtIn();
 }
 
 /**
@@ -445,16 +2989,17 @@ locations[13].add_location("north", &locations[3]);
  * @param command The command to execute.
  * @param args The arguments for the command.
  */
-void Game::executeCommand(std::string command, std::vector<std::string> args) {
-    command = toLowercase(command);
+void Game::executeCommand(std::pmr::string command, Args args) {
+    std::transform(command.begin(), command.end(), command.begin(), ::tolower);
 
-    if (commands.find(command) != commands.end()) {
+    auto found = commands.find(std::string_view(command));
+    if (found != commands.end()) {
         for (auto& arg : args) {
-            arg = toLowercase(arg);
+            std::transform(arg.begin(), arg.end(), arg.begin(), ::tolower);
         }
-        commands[command](this, args);
+        found->second(this, std::move(args));
     } else {
-        std::cout << "Unknown command! Type 'help' for a list of commands." << std::endl;
+        out << "Unknown command! Type 'help' for a list of commands." << std::endl;
     }
 }
 
@@ -462,11 +3007,11 @@ void Game::executeCommand(std::string command, std::vector<std::string> args) {
  * @brief Displays the details of the current location.
  * @param target Unused.
  */
-void Game::look(std::vector<std::string> target) {
+void Game::look(Args target) {
     if (currentLocation) {
-        std::cout << *currentLocation << std::endl;
+        currentLocation->print(out, *world, visited) << std::endl;
     } else {
-        std::cout << "You are in an unknown place..." << std::endl;
+        out << "You are in an unknown place..." << std::endl;
     }
 }
 
@@ -474,19 +3019,19 @@ void Game::look(std::vector<std::string> target) {
  * @brief Quits the game.
  * @param target Unused.
  */
-void Game::quit(std::vector<std::string> target) {
-    std::cout << "Quitting game..." << std::endl;
-    exit(0);
+void Game::quit(Args target) {
+    out << "Quitting game..." << std::endl;
+    inProgress = false;
 }
 
 /**
  * @brief Displays a list of available commands.
  * @param target Unused.
  */
-void Game::showHelp(std::vector<std::string> target) {
-    std::cout << "Available commands:" << std::endl;
+void Game::showHelp(Args target) {
+    out << "Available commands:" << std::endl;
     for (const auto& cmd : commands) {
-        std::cout << " - " << cmd.first << std::endl;
+        out << " - " << cmd.first << std::endl;
     }
 }
 
@@ -494,56 +3039,55 @@ void Game::showHelp(std::vector<std::string> target) {
  * @brief Displays the player's inventory.
  * @param target Unused.
  */
-void Game::showInventory(std::vector<std::string> target) {
+void Game::showInventory(Args target) {
     if (inventory.empty()) {
-        std::cout << "Your inventory is empty.\n";
-        currentWeight = 0;
+        out << "Your inventory is empty.\n";
     } else {
-        std::cout << "Your inventory contains:\n";
-        for (const auto& item : inventory) {
-            std::cout << "- " << item << std::endl;
+        out << "Your inventory contains:\n";
+        for (const auto& stack : inventory.stacks()) {
+            out << "- ";
+            if (stack.count > 1) out << stack.count << "x ";
+            out << stack.item << std::endl;
         }
+        out << "Awesome points carried: " << inventory.points() << "\n";
     }
-    std::cout << "Current weight: " << currentWeight << "lbs\n";
+    out << "Current weight: " << inventory.weight() / 100.0 << "/" << maxWeight << "lbs\n";
 }
 
 /**
  * @brief Allows the player to take an item from the current location.
  * @param args The arguments specifying the item to take.
  */
-void Game::take(std::vector<std::string> args) {
+void Game::take(Args args) {
     // The way we are parsing through the input and discarding words such as "the" and finding the correct target is ai generated.
     // This code is also in most commands as they requre the same parsing.
-    std::vector<std::string> articles = {"the", "a"};
+    static const std::array<std::string_view, 2> articles = {"the", "a"};
 
     if (args.size() > 0 && std::find(articles.begin(), articles.end(), args[0]) != articles.end()) {
         args.erase(args.begin());
     }
 
-    std::string fullItemName = "";
-    for (const auto& arg : args) {
-        if (!fullItemName.empty()) fullItemName += " ";
-        fullItemName += arg;
-    }
+    std::pmr::string fullItemName = joinArgs(args);
 
     bool itemFound = false;
-    for (auto& item : currentLocation->get_items()) {
-        if (toLowercase(item.getName()) == toLowercase(fullItemName)) {
+    for (const auto& item : currentLocation->get_items()) {
+        if (equalsIgnoreCase(item.getName(), fullItemName)) {
             itemFound = true;
-            if (currentWeight + item.getWeight() > 30) {
-                std::cout << "You cannot take the " << fullItemName << ". It would exceed your weight limit of 30 lbs.\n";
+            if (inventory.weight() + item.getWeightHundredths() > maxWeight * 100) {
+                out << "You cannot take the " << fullItemName << ". It would exceed your weight limit of " << maxWeight << " lbs.\n";
                 return;
             }
-            currentLocation->remove_item(item);
-            inventory.push_back(item);
-            currentWeight += item.getWeight();
-            std::cout << "You have taken the " << fullItemName << "." << std::endl;
+            inventory.add(item);
+            touchedItems.push_back(item.getId());
+            out << "You have taken the " << fullItemName << "." << std::endl;
+            journal.append(EventJournal::EventType::Take, currentLocation->getId(), 0, item.getName());
+            currentLocation->remove_item(item); // Invalidates item, so it goes last
             break;
         }
     }
 
     if (!itemFound) {
-        std::cout << "Item not found in this location." << std::endl;
+        out << "Item not found in this location." << std::endl;
     }
 }
 
@@ -551,44 +3095,45 @@ void Game::take(std::vector<std::string> args) {
  * @brief Allows the player to give an item to the current location.
  * @param target The arguments specifying the item to give.
  */
-void Game::give(std::vector<std::string> target) {
-    std::vector<std::string> articles = {"the", "a"};
-    if (std::find(articles.begin(), articles.end(), target[0]) != articles.end()) {
+void Game::give(Args target) {
+    static const std::array<std::string_view, 2> articles = {"the", "a"};
+    if (!target.empty() && std::find(articles.begin(), articles.end(), target[0]) != articles.end()) {
         target.erase(target.begin());
     }
-
-    std::string itemName;
-    for (const auto& arg : target) {
-        if (!itemName.empty()) itemName += " ";
-        itemName += arg;
+    if (target.empty()) {
+        out << "Usage: give <item>\nExample: give neck\n";
+        return;
     }
 
-    std::string lowerItemName = toLowercase(itemName);
-
-    auto it = std::find_if(inventory.begin(), inventory.end(),
-        [&](const Item& i) { return toLowercase(i.getName()) == lowerItemName; });
+    std::pmr::string itemName = joinArgs(target);
 
-    if (it == inventory.end()) {
-        std::cout << "You don't have a " << itemName << " in your inventory.\n";
+    std::optional<Item> given = inventory.remove(world->itemIndexOf(itemName));
+    if (!given) {
+        out << "You don't have a " << itemName << " in your inventory.\n";
         return;
     }
 
-    Item item = *it;
-    inventory.erase(it);
-    currentWeight -= item.getWeight();
-    std::cout << "You gave the " << itemName << ".\n";
+    const Item& item = *given;
+    touchedItems.push_back(item.getId());
+    out << "You gave the " << itemName << ".\n";
+    journal.append(EventJournal::EventType::Give, currentLocation->getId(), 0, item.getName());
 
     if (currentLocation->getName() == "VIP Lounge") {
         if (item.getCalories() > 0) {
             caloriesNeeded = std::max(0, caloriesNeeded - item.getCalories());
-            std::cout << "Dean slaps the " << itemName << " on to the guitar it was worth "
+            pointsDelivered += item.getCalories();
+            out << "Dean slaps the " << itemName << " on to the guitar it was worth "
                       << item.getCalories() << " awesomeness points). Remaining needed: "
                       << caloriesNeeded << "\n";
         } else {
-            std::cout << "Dean says thanks you for the " << itemName
+            out << "Dean says thanks you for the " << itemName
                       << " but absurdly a portal opes up in the floor and you're teleported!\n";
             currentLocation = randomLocation();
-            std::cout << "You are now in: " << currentLocation->getName() << "\n";
+            world->touch(currentLocation->getId());
+            visited[currentLocation->getId()] = true;
+            isInPotty = currentLocation->getName() == "Porta-Potty";
+            journal.append(EventJournal::EventType::Portal, currentLocation->getId());
+            out << "You are now in: " << currentLocation->getName() << "\n";
         }
     } else {
         currentLocation->add_item(item);
@@ -599,47 +3144,53 @@ void Game::give(std::vector<std::string> target) {
  * @brief Allows the player to move to a new location.
  * @param args The arguments specifying the direction to move.
  */
-void Game::go(std::vector<std::string> args) {
-    currentLocation->set_visited();
+void Game::go(Args args) {
+    visited[currentLocation->getId()] = true;
 
     if (args.empty()) {
-        std::cout << "Go where? Please specify a direction.\n";
+        out << "Go where? Please specify a direction.\n";
         return;
     }
 
-    std::vector<std::string> ignoredWords = {"to", "the"};
+    static const std::array<std::string_view, 2> ignoredWords = {"to", "the"};
     args.erase(std::remove_if(args.begin(), args.end(),
-        [&](const std::string& word) {
+        [&](const std::pmr::string& word) {
             return std::find(ignoredWords.begin(), ignoredWords.end(), toLowercase(word)) != ignoredWords.end();
         }), args.end());
 
 
-    std::string direction = "";
-    for (const auto& word : args) {
-        if (!direction.empty()) direction += " ";
-        direction += word;
-    }
+    std::pmr::string direction = joinArgs(args);
 
 
-    direction = toLowercase(direction);
+    std::transform(direction.begin(), direction.end(), direction.begin(), ::tolower);
 
     // Special case for "hell"
-    if (direction == "hell" && isInPotty) {
-        std::cout << "A swirling vortex opens beneath you... Welcome to Hell!\n";
-        currentLocation = &locations[12]; // Move player to Hell
-        std::cout << *currentLocation << std::endl;
+    size_t hell = world->indexOf("hell");
+    if (direction == "hell" && isInPotty && hell != World::npos) {
+        out << "A swirling vortex opens beneath you... Welcome to Hell!\n";
+        currentLocation = &world->locations[hell]; // Move player to Hell
+        world->touch(hell);
+        visited[hell] = true;
+        isInPotty = false;
+        journal.append(EventJournal::EventType::Go, currentLocation->getId());
+        if (!batching) {
+            currentLocation->print(out, *world, visited) << std::endl;
+        }
         return;
     }
 
     // Check if the current location has a neighbor in that direction
     auto it = currentLocation->neighbors.find(direction);
     if (it == currentLocation->neighbors.end()) {
-        std::cout << "You can't go that way.\n";
+        out << "You can't go that way.\n";
         return;
     }
 
     // Move to the new location
     currentLocation = it->second;
+    world->touch(currentLocation->getId());
+    visited[currentLocation->getId()] = true;
+    journal.append(EventJournal::EventType::Go, currentLocation->getId());
 
     if (currentLocation->getName() == "Porta-Potty") {
         isInPotty = true;
@@ -647,115 +3198,99 @@ void Game::go(std::vector<std::string> args) {
         isInPotty = false;
     }
 
-    std::cout << *currentLocation << std::endl;
+    // Inside a batch the location is rendered once, after the last command
+    if (!batching) {
+        currentLocation->print(out, *world, visited) << std::endl;
+    }
 }
 /**
  * @brief Returns a random location from the list of locations.
  * @return A pointer to a random location.
  */
 Location* Game::randomLocation() {
-    if (locations.empty()) {
+    if (world->locations.empty()) {
         return nullptr;
     }
 
     static std::random_device rd;
     static std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dist(0, locations.size() - 1);
+    std::uniform_int_distribution<int> dist(0, world->locations.size() - 1);
 
-    return &locations[dist(gen)];
+    return &world->locations[dist(gen)];
 }
 
 /**
  * @brief Allows the player to kiss an NPC.
  * @param args The arguments specifying the NPC to kiss.
  */
-void Game::hug(std::vector<std::string> args) {
+void Game::hug(Args args) {
     if (!currentLocation) {
-        std::cout << "No locations available to talk to." << std::endl;
+        out << "No locations available to talk to." << std::endl;
         return;
     }
 
-    std::vector<NPC>& npcs = currentLocation->get_npcs();
-    if (npcs.empty()) {
-        std::cout << "There are no NPCs to talk to in this location." << std::endl;
+    if (currentLocation->get_npcs().empty() && world->crowd.groupsAt(currentLocation->getId()).empty()) {
+        out << "There are no NPCs to talk to in this location." << std::endl;
         return;
     }
 
     if (args.empty()) {
-        std::cout << "You need to specify which NPC to talk to." << std::endl;
+        out << "You need to specify which NPC to talk to." << std::endl;
         return;
     }
 
-    std::vector<std::string> ignoredWords = {"to"};
+    static const std::array<std::string_view, 1> ignoredWords = {"to"};
     if (std::find(ignoredWords.begin(), ignoredWords.end(), args[0]) != ignoredWords.end()) {
         args.erase(args.begin());
     }
 
-    std::string npcName = "";
-    for (const auto& arg : args) {
-        if (!npcName.empty()) npcName += " ";
-        npcName += arg;
-    }
+    std::pmr::string npcName = joinArgs(args);
 
-    std::string lowerNpcName = toLowercase(npcName);
-
-    for (NPC& npc : npcs) {
-        if (toLowercase(npc.getName()) == lowerNpcName) {
-            std::cout << "You give a hug to " << npc.getName() << "... not very metal of you tbh" << std::endl;
-            return;
-        }
+    size_t npcId = findNpcHere(npcName);
+    if (npcId != World::npos) {
+        out << "You give a hug to " << world->npcs[npcId].getName() << "... not very metal of you tbh" << std::endl;
+        return;
     }
 
     // If no NPC is found with the specified name
-    std::cout << "No NPC named " << npcName << " in this location." << std::endl;
+    out << "No NPC named " << npcName << " in this location." << std::endl;
 }
 
 /**
  * @brief Allows the player to talk to an NPC.
  * @param args The arguments specifying the NPC to talk to.
  */
-void Game::talk(std::vector<std::string> args) {
+void Game::talk(Args args) {
     if (!currentLocation) {
-        std::cout << "No locations available to talk to." << std::endl;
+        out << "No locations available to talk to." << std::endl;
         return;
     }
 
-    std::vector<NPC>& npcs = currentLocation->get_npcs();
-    if (npcs.empty()) {
-        std::cout << "There are no NPCs to talk to in this location." << std::endl;
+    if (currentLocation->get_npcs().empty() && world->crowd.groupsAt(currentLocation->getId()).empty()) {
+        out << "There are no NPCs to talk to in this location." << std::endl;
         return;
     }
 
     if (args.empty()) {
-        std::cout << "You need to specify which NPC to talk to." << std::endl;
+        out << "You need to specify which NPC to talk to." << std::endl;
         return;
     }
 
-    std::vector<std::string> ignoredWords = {"to"};
+    static const std::array<std::string_view, 1> ignoredWords = {"to"};
     if (std::find(ignoredWords.begin(), ignoredWords.end(), args[0]) != ignoredWords.end()) {
         args.erase(args.begin());
     }
 
-    std::string npcName = "";
-    for (const auto& arg : args) {
-        if (!npcName.empty()) npcName += " ";
-        npcName += arg;
-    }
-
-    std::string lowerNpcName = toLowercase(npcName);
-
-    bool npcFound = false;
-    for (NPC& npc : npcs) {
-        if (toLowercase(npc.getName()) == lowerNpcName) {
-            std::cout << "You start a conversation with " << npc.getName() << "..." << std::endl;
-            std::cout << npc.getMessage() << std::endl;
-            npcFound = true;
-            break;
-        }
-    }
+    std::pmr::string npcName = joinArgs(args);
 
-    if (!npcFound) {
-        std::cout << "No NPC named " << npcName << " in this location." << std::endl;
+    size_t npcId = findNpcHere(npcName);
+    if (npcId != World::npos) {
+        NPC& npc = world->npcs[npcId];
+        out << "You start a conversation with " << npc.getName() << "..." << std::endl;
+        out << npc.getMessage() << std::endl;
+        journal.append(EventJournal::EventType::Talk, currentLocation->getId(), npcId);
+    } else {
+        out << "No NPC named " << npcName << " in this location." << std::endl;
     }
 }
 
@@ -763,46 +3298,201 @@ void Game::talk(std::vector<std::string> args) {
  * @brief Teleports the player to a discovered location.
  * @param target The arguments specifying the location to teleport to.
  */
-void Game::teleport(std::vector<std::string> target) {
+void Game::teleport(Args target) {
     if (target.empty()) {
-        std::cout << "Usage: teleport to <location>\nExample: teleport to Dormitory\n";
+        out << "Usage: teleport to <location>\nExample: teleport to Dormitory\n";
         return;
     }
 
-    std::vector<std::string> ignoredWords = {"to", "the"};
+    static const std::array<std::string_view, 2> ignoredWords = {"to", "the"};
     target.erase(std::remove_if(target.begin(), target.end(),
-        [&](const std::string& word) {
+        [&](const std::pmr::string& word) {
             return std::find(ignoredWords.begin(), ignoredWords.end(), toLowercase(word)) != ignoredWords.end();
         }), target.end());
 
-    std::string locationName = "";
-    for (const auto& word : target) {
-        if (!locationName.empty()) locationName += " ";
-        locationName += word;
+    std::pmr::string locationName = joinArgs(target);
+
+    size_t found = world->indexOf(locationName);
+    if (found == World::npos) {
+        out << "Location '" << locationName << "' does not exist.\n";
+        return;
     }
 
-    std::string lowerLocationName = toLowercase(locationName);
+    if (!visited[found]) {
+        out << "You have not discovered '" << world->locations[found].getName() << "' yet.\n";
+        return;
+    }
+    currentLocation = &world->locations[found];
+    world->touch(found);
+    isInPotty = currentLocation->getName() == "Porta-Potty";
+    journal.append(EventJournal::EventType::Teleport, currentLocation->getId());
 
-    bool locationFound = false;
-    for (size_t i = 0; i < locations.size(); ++i) {
-        std::string lowerLocName = toLowercase(locations[i].getName());
-        if (lowerLocName == lowerLocationName) {
-            if (!locations[i].get_visited()) {
-                std::cout << "You have not discovered '" << locations[i].getName() << "' yet.\n";
-                return;
+    out << "You teleported to " << currentLocation->getName() << ".\n";
+}
+
+/**
+ * @brief Lists the locations, items and NPCs whose names or descriptions mention some words.
+ * @param target The words to search for.
+ */
+void Game::search(Args target) {
+    if (target.empty()) {
+        out << "Usage: search <words>\nExample: search floyd rose\n";
+        return;
+    }
+
+    std::pmr::string query = joinArgs(target);
+    std::vector<SearchIndex::Hit> hits = world->search.find(query, 10);
+    if (hits.empty()) {
+        out << "Nothing mentions '" << query << "'.\n";
+        return;
+    }
+
+    static const std::array<std::string_view, 3> kindNames = {"Location", "Item", "NPC"};
+    out << "Results for '" << query << "':\n";
+    for (const auto& hit : hits) {
+        out << "- " << kindNames[static_cast<size_t>(hit.kind)] << ": " << hit.name << "\n";
+    }
+}
+
+/**
+ * @brief Shows how much memory each subsystem holds from the system allocator. Takes no arguments.
+ */
+void Game::memstats(Args) {
+    if (!TrackingResource::enabled()) {
+        out << "Memory tracking is off. Start the game with --memstats to turn it on.\n";
+        return;
+    }
+    TrackingResource::report(out);
+}
+
+/**
+ * @brief Lists the fastest finishes in the process and the player's rank.
+ * @param target How many finishes to list; ten if empty.
+ */
+void Game::scores(Args target) {
+    size_t count = 10;
+    if (!target.empty()) {
+        try {
+            count = std::stoul(std::string(target[0]));
+        } catch (const std::exception&) {
+            out << "Usage: scores [how many]\n";
+            return;
+        }
+    }
+    printScores(count);
+}
+
+/**
+ * @brief Splits an input line into a batch of commands separated by ';', or by "then" when a command word follows it.
+ * @param input The raw input line, e.g. "go north; take pick then go south".
+ * @return The commands in order, each as the command word followed by its arguments.
+ */
+std::pmr::vector<Args> Game::parseBatch(std::string_view input) {
+    std::pmr::vector<Args> batch(1, &commandPool);
+    std::pmr::string word(&commandPool);
+    bool afterThen = false; // The last word was "then", inside a command
+
+    // "then" only separates commands when a command word follows it, so names like "Then & Now" survive
+    auto endWord = [&]() {
+        if (word.empty()) return;
+        if (afterThen) {
+            afterThen = false;
+            if (commands.count(std::string_view(toLowercase(word)))) {
+                batch.emplace_back();
+            } else {
+                batch.back().push_back(std::pmr::string("then", &commandPool));
             }
-            currentLocation = &locations[i];
-            locationFound = true;
-            break;
+        }
+        if (equalsIgnoreCase(word, "then") && !batch.back().empty()) {
+            afterThen = true;
+        } else {
+            batch.back().push_back(word);
+        }
+        word.clear();
+    };
+    auto endCommand = [&]() {
+        endWord();
+        if (afterThen) batch.back().push_back(std::pmr::string("then", &commandPool));
+        afterThen = false;
+    };
+
+    for (char c : input) {
+        if (c == ';') {
+            endCommand();
+            batch.emplace_back();
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            endWord();
+        } else {
+            word += c;
         }
     }
+    endCommand();
 
-    if (!locationFound) {
-        std::cout << "Location '" << locationName << "' does not exist.\n";
-        return;
+    batch.erase(std::remove_if(batch.begin(), batch.end(),
+        [](const Args& cmd) { return cmd.empty(); }), batch.end());
+    return batch;
+}
+
+/**
+ * @brief Runs a batch of commands as one unit and flushes their output once.
+ * @param batch The commands to run, as returned by parseBatch().
+ */
+void Game::runBatch(const std::pmr::vector<Args>& batch) {
+    // Swap in a reloaded world between batches; the rebuild itself happened on the watcher thread
+    if (watcher) {
+        if (std::shared_ptr<World> next = watcher->poll()) {
+            adoptWorld(std::move(next));
+        }
+    }
+    advanceClock();
+    commitState(currentLocation->getId(), true); // What the timers changed belongs to the current version, not the next command
+
+    batching = batch.size() > 1;
+    bool moved = false; // A batch that comes back to where it started still moved
+
+    for (const auto& cmd : batch) {
+        size_t startLocation = currentLocation->getId();
+        recordItems(startLocation);
+        executeCommand(std::pmr::string(cmd[0], &commandPool), Args(cmd.begin() + 1, cmd.end(), &commandPool));
+        ++commandCount;
+        moved = moved || currentLocation->getId() != startLocation;
+        commitState(startLocation);
+        if (caloriesNeeded <= 0 || !inProgress) break;
     }
 
-    std::cout << "You teleported to " << currentLocation->getName() << ".\n";
+    if (batching && inProgress && moved) {
+        currentLocation->print(out, *world, visited) << std::endl;
+    }
+    batching = false;
+
+    if (caloriesNeeded <= 0) {
+    	out << "\n\nDean rummages frantically through the parts, mumbling to himself:\n"
+    	<< "\"Neck joint... needs the Floyd Rose... where's the-\"\n"
+    	<< "*CLANG* He drops a pickup, curses in dead languages, then freezes.\n\n"
+    	<< "\"YES! THIS IS IT!\"\n"
+    	<< "Dean's hands blur as he slams components together - \n"
+    	<< "mahogany body screaming, strings glowing with forbidden energy.\n\n"
+    	<< "He thrusts the finished guitar into your hands:\n"
+    	<< "\"THE HELLAXE! Now go channel the rift before Metalapokolips collapses!\"\n\n"
+    	<< "You stride onto the Main Stage. The crowd's roar becomes silence.\n"
+    	<< "First chord - reality bends. Second chord - skies crack.\n"
+    	<< "By the solo, the very fabric of the festival stabilizes,\n"
+    	<< "pyrotechnics rewriting the laws of physics.\n\n"
+    	<< "When the feedback dies, you're left with:\n"
+    	<< "- A destroyed PA system\n"
+    	<< "- Three record label contracts\n"
+    	<< "- A crowd too hoarse to even whisper 'encore'\n\n"
+    	<< "METALAPOKOLIPS HAS BEEN SAVED. \\m/\n";
+    	inProgress = false;
+    	finish();
+    }
+
+    // One write per batch instead of one per command
+    const std::string text = out.str();
+    std::cout << text << std::flush;
+    if (spectatorFeed) spectatorFeed->publish(text);
+    out.str("");
+    out.clear();
 }
 
 /**
@@ -815,53 +3505,82 @@ void Game::play() {
     std::string input;
     while (inProgress) {
         std::cout << "> ";
-        std::getline(std::cin, input);
+        if (!std::getline(std::cin, input)) break;
+        if (spectatorFeed) spectatorFeed->publish("> " + input + "\n");
 
-        if (input.empty()) continue;
+        {
+            std::pmr::vector<Args> batch = parseBatch(input);
+            if (!batch.empty()) runBatch(batch);
+        }
 
-        std::vector<std::string> args;
-        std::string command;
-        size_t pos = input.find(' ');
-        if (pos != std::string::npos) {
-            command = input.substr(0, pos);
-            std::string remaining = input.substr(pos + 1);
+        // Everything the batch allocated is dropped at once
+        commandPool.release();
+    }
+}
 
-            size_t argPos;
-            while ((argPos = remaining.find(' ')) != std::string::npos) {
-                args.push_back(remaining.substr(0, argPos));
-                remaining = remaining.substr(argPos + 1);
+int main(int argc, char* argv[]) {
+    std::string journalDirectory;
+    std::string worldFile;
+    std::vector<std::string> spectatorFiles;
+    size_t residentRegions = 0;
+    bool streamed = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--journal" && i + 1 < argc) {
+            journalDirectory = argv[++i];
+        } else if (arg == "--world" && i + 1 < argc) {
+            worldFile = argv[++i];
+        } else if (arg == "--memstats") {
+            TrackingResource::enable();
+        } else if (arg == "--resident-regions" && i + 1 < argc) {
+            std::string count = argv[++i];
+            try {
+                if (count.empty() || !std::all_of(count.begin(), count.end(), ::isdigit)) throw std::invalid_argument(count);
+                residentRegions = std::stoul(count);
+                streamed = true;
+            } catch (const std::exception&) {
+                std::cerr << "--resident-regions takes a whole number of regions, not '" << count << "'" << std::endl;
+                return 1;
             }
-            if (!remaining.empty()) args.push_back(remaining);
+        } else if (arg == "--spectate" && i + 1 < argc) {
+            spectatorFiles.push_back(argv[++i]);
+        } else if (arg == "--dump-journal" && i + 1 < argc) {
+            // Offline analytics: read the segments without touching the live process
+            for (const auto& event : EventJournal::read(argv[++i])) {
+                std::cout << EventJournal::typeName(event.type) << '\t' << event.location << '\t'
+                          << event.subject << '\t' << event.name << '\n';
+            }
+            return 0;
         } else {
-            command = input;
-        }
-
-        executeCommand(command, args);
-        if (caloriesNeeded <= 0) {
-        	std::cout << "\n\nDean rummages frantically through the parts, mumbling to himself:\n"
-        	<< "\"Neck joint... needs the Floyd Rose... where's the-\"\n"
-        	<< "*CLANG* He drops a pickup, curses in dead languages, then freezes.\n\n"
-        	<< "\"YES! THIS IS IT!\"\n"
-        	<< "Dean's hands blur as he slams components together - \n"
-        	<< "mahogany body screaming, strings glowing with forbidden energy.\n\n"
-        	<< "He thrusts the finished guitar into your hands:\n"
-        	<< "\"THE HELLAXE! Now go channel the rift before Metalapokolips collapses!\"\n\n"
-        	<< "You stride onto the Main Stage. The crowd's roar becomes silence.\n"
-        	<< "First chord - reality bends. Second chord - skies crack.\n"
-        	<< "By the solo, the very fabric of the festival stabilizes,\n"
-        	<< "pyrotechnics rewriting the laws of physics.\n\n"
-        	<< "When the feedback dies, you're left with:\n"
-        	<< "- A destroyed PA system\n"
-        	<< "- Three record label contracts\n"
-        	<< "- A crowd too hoarse to even whisper 'encore'\n\n"
-        	<< "METALAPOKOLIPS HAS BEEN SAVED. \\m/\n";
-        	inProgress = false;
-    	}
-    }
-}
-
-int main() {
+            std::cerr << "Usage: " << argv[0] << " [--world <file> [--resident-regions <n>]] [--journal <dir>] [--spectate <file>]... [--memstats] [--dump-journal <dir>]" << std::endl;
+            return 1;
+        }
+    }
+    if (streamed && worldFile.empty()) {
+        std::cerr << "--resident-regions streams a --world file, so it needs --world too" << std::endl;
+        return 1;
+    }
+
     Game game;
+    try {
+        if (!journalDirectory.empty()) {
+            game.openJournal(journalDirectory, residentRegions);
+        }
+        if (!worldFile.empty()) {
+            game.watchWorld(worldFile, residentRegions);
+        }
+        for (const auto& file : spectatorFiles) {
+            game.addSpectator(file);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
     game.play();
+    if (TrackingResource::enabled()) {
+        std::cout << "\n";
+        TrackingResource::report(std::cout);
+    }
     return 0;
 }
\ No newline at end of file